@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * Read-only array owned by someone else, such as a vector or a mapped file.
+ */
+template <typename Type>
+class ArrayView
+{
+public:
+    ArrayView() = default;
+    ArrayView(const Type* data, size_t size) : m_data(data), m_size(size) {}
+    ArrayView(const std::vector<Type>& v) : m_data(v.data()), m_size(v.size()) {}
+
+    const Type* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const Type* begin() const { return m_data; }
+    const Type* end() const { return m_data + m_size; }
+    const Type& back() const { return m_data[m_size - 1]; }
+
+    const Type& operator[](size_t i) const { return m_data[i]; }
+    const Type& at(size_t i) const
+    {
+        if (i >= m_size)
+            throw std::out_of_range("ArrayView::at");
+        return m_data[i];
+    }
+
+private:
+    const Type* m_data = nullptr;
+    size_t m_size = 0;
+};
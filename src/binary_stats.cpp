@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "util.hpp"
+#include "simulator.hpp"
+
+/*
+ * stats.bin, in the byte order of the host (little endian on x86):
+ *
+ *   char     magic[4] = "FSTB"
+ *   uint32   version = 1
+ *   uint32   flags  (STATS_REGISTERS | STATS_MEMORY | STATS_MEMORY_ACCESS)
+ *   uint32   code_num
+ *   int64    dynamic_inst, samples, simpoints
+ *   uint64   memory_num, memory_idx_max
+ *   int64    pc_called[code_num]
+ *   uint32   inst_num, {uint32 opcode, int64 count}[inst_num]
+ *   if STATS_REGISTERS:
+ *     uint32 reg[32], freg[32]
+ *   if STATS_MEMORY, the ranges holding non-zero words:
+ *     uint32 range_num, {uint32 begin, uint32 len, uint32 words[len]}[range_num]
+ *   if STATS_MEMORY_ACCESS, sorted by the index:
+ *     uint64 access_num, {uint32 idx, uint32 count}[access_num]
+ *
+ * tools/stats2text.py converts it to the text logs.
+ */
+namespace
+{
+
+constexpr uint32_t STATS_VERSION = 1;
+constexpr uint32_t STATS_REGISTERS = 1;
+constexpr uint32_t STATS_MEMORY = 2;
+constexpr uint32_t STATS_MEMORY_ACCESS = 4;
+
+// Zero words shorter than this are kept inside a range
+constexpr size_t RANGE_GAP = 8;
+
+class Buffer
+{
+public:
+    template <class T>
+    void put(T value)
+    {
+        auto pos = m_data.size();
+        m_data.resize(pos + sizeof value);
+        std::memcpy(&m_data[pos], &value, sizeof value);
+    }
+
+    template <class T>
+    void put(const T* values, size_t n)
+    {
+        auto pos = m_data.size();
+        m_data.resize(pos + sizeof(T) * n);
+        if (n > 0)
+            std::memcpy(&m_data[pos], values, sizeof(T) * n);
+    }
+
+    const std::vector<char>& data() const { return m_data; }
+
+private:
+    std::vector<char> m_data;
+};
+
+}  // namespace
+
+void Simulator::dumpBinary(
+    const Counters& cnt, bool output_memory, const Simulator* state)
+{
+    uint32_t flags = 0;
+    if (state != nullptr)
+        flags |= STATS_REGISTERS;
+    if (state != nullptr && output_memory)
+        flags |= STATS_MEMORY;
+    if (output_memory)
+        flags |= STATS_MEMORY_ACCESS;
+
+    Buffer buf;
+    buf.put("FSTB", 4);
+    buf.put(STATS_VERSION);
+    buf.put(flags);
+    buf.put(static_cast<uint32_t>(cnt.pc_called.size()));
+    buf.put(cnt.dynamic_inst);
+    buf.put(cnt.samples);
+    buf.put(cnt.simpoints);
+    buf.put(static_cast<uint64_t>(state != nullptr ? state->m_memory_num : 0));
+    buf.put(static_cast<uint64_t>(cnt.memory_idx_max));
+
+    buf.put(cnt.pc_called.data(), cnt.pc_called.size());
+
+    buf.put(static_cast<uint32_t>(cnt.inst.size()));
+    for (const auto& p : cnt.inst) {
+        buf.put(static_cast<uint32_t>(p.first));
+        buf.put(p.second);
+    }
+
+    if (flags & STATS_REGISTERS) {
+        for (auto r : state->m_reg)
+            buf.put(static_cast<uint32_t>(r));
+        for (auto f : state->m_freg)
+            buf.put(ftou(f));
+    }
+
+    if (flags & STATS_MEMORY) {
+        const auto* memory = state->m_memory;
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        size_t i = 0;
+        while (i < state->m_memory_num) {
+            if (memory[i] == 0) {
+                i++;
+                continue;
+            }
+            auto begin = i, end = i + 1;
+            for (i++; i < state->m_memory_num && i < end + RANGE_GAP; i++) {
+                if (memory[i] != 0)
+                    end = i + 1;
+            }
+            i = end;
+            ranges.emplace_back(begin, end - begin);
+        }
+
+        buf.put(static_cast<uint32_t>(ranges.size()));
+        for (const auto& r : ranges) {
+            buf.put(r.first);
+            buf.put(r.second);
+            buf.put(memory + r.first, r.second);
+        }
+    }
+
+    if (flags & STATS_MEMORY_ACCESS) {
+        std::vector<std::pair<uint32_t, uint32_t>> accesses(
+            cnt.memory_access.begin(), cnt.memory_access.end());
+        std::sort(accesses.begin(), accesses.end());
+
+        buf.put(static_cast<uint64_t>(accesses.size()));
+        for (const auto& a : accesses) {
+            buf.put(a.first);
+            buf.put(a.second);
+        }
+    }
+
+    auto fp = std::fopen("stats.bin", "wb");
+    if (fp == nullptr)
+        FAIL("# Error: File stats.bin couldn't be opened for writing");
+    const auto& data = buf.data();
+    auto written = std::fwrite(data.data(), 1, data.size(), fp);
+    std::fclose(fp);
+    if (written != data.size())
+        FAIL("# Error: Couldn't write stats.bin");
+}
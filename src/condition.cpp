@@ -0,0 +1,374 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include "condition.hpp"
+
+class Condition::Parser
+{
+public:
+    Parser(const std::string& src, std::vector<Code>& code)
+        : m_src(src), m_code(code) {}
+
+    bool parse(std::string& error, size_t& stack_size)
+    {
+        if (not parseOr() || not expectEnd()) {
+            error = m_error;
+            return false;
+        }
+        stack_size = m_max_depth;
+        return true;
+    }
+
+private:
+    const std::string& m_src;
+    std::vector<Code>& m_code;
+    size_t m_pos = 0;
+    size_t m_depth = 0, m_max_depth = 0;
+    std::string m_error;
+
+    int charAt(size_t pos) const
+    {
+        return static_cast<unsigned char>(m_src[pos]);
+    }
+
+    bool fail(const std::string& msg)
+    {
+        if (m_error.empty())
+            m_error = msg + " at column " + std::to_string(m_pos + 1);
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while (m_pos < m_src.size() && std::isspace(charAt(m_pos)))
+            m_pos++;
+    }
+
+    bool accept(const char* token)
+    {
+        skipSpace();
+        auto len = std::strlen(token);
+        if (m_src.compare(m_pos, len, token) != 0)
+            return false;
+        m_pos += len;
+        return true;
+    }
+
+    bool expectEnd()
+    {
+        skipSpace();
+        return m_pos == m_src.size() || fail("Unexpected character");
+    }
+
+    // Emit an operation popping 'pop' values and pushing one
+    void emit(Op op, int pop, uint32_t idx = 0, double value = 0)
+    {
+        m_code.emplace_back(Code{op, idx, value});
+        m_depth = m_depth - static_cast<size_t>(pop) + 1;
+        if (m_max_depth < m_depth)
+            m_max_depth = m_depth;
+    }
+
+    bool parseOr()
+    {
+        if (not parseAnd())
+            return false;
+        while (accept("||")) {
+            if (not parseAnd())
+                return false;
+            emit(Op::Or, 2);
+        }
+        return true;
+    }
+
+    bool parseAnd()
+    {
+        if (not parseNot())
+            return false;
+        while (accept("&&")) {
+            if (not parseNot())
+                return false;
+            emit(Op::And, 2);
+        }
+        return true;
+    }
+
+    bool parseNot()
+    {
+        skipSpace();
+        if (m_src.compare(m_pos, 1, "!") == 0
+            && m_src.compare(m_pos, 2, "!=") != 0) {
+            m_pos++;
+            if (not parseNot())
+                return false;
+            emit(Op::Not, 1);
+            return true;
+        }
+        return parseCmp();
+    }
+
+    bool parseCmp()
+    {
+        if (not parseSum())
+            return false;
+
+        // longer tokens first
+        static const struct {
+            const char* token;
+            Op op;
+        } cmps[] = {
+            {"==", Op::Eq},
+            {"!=", Op::Ne},
+            {"<=", Op::Le},
+            {">=", Op::Ge},
+            {"<", Op::Lt},
+            {">", Op::Gt},
+        };
+        for (const auto& c : cmps) {
+            if (accept(c.token)) {
+                if (not parseSum())
+                    return false;
+                emit(c.op, 2);
+                return true;
+            }
+        }
+        return true;
+    }
+
+    bool parseSum()
+    {
+        if (not parseTerm())
+            return false;
+        while (true) {
+            if (accept("+")) {
+                if (not parseTerm())
+                    return false;
+                emit(Op::Add, 2);
+            } else if (accept("-")) {
+                if (not parseTerm())
+                    return false;
+                emit(Op::Sub, 2);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parseTerm()
+    {
+        if (not parseUnary())
+            return false;
+        while (true) {
+            if (accept("*")) {
+                if (not parseUnary())
+                    return false;
+                emit(Op::Mul, 2);
+            } else if (accept("/")) {
+                if (not parseUnary())
+                    return false;
+                emit(Op::Div, 2);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parseUnary()
+    {
+        if (accept("-")) {
+            if (not parseUnary())
+                return false;
+            emit(Op::Neg, 1);
+            return true;
+        }
+        return parsePrimary();
+    }
+
+    bool parseRegIndex(uint32_t& idx)
+    {
+        auto begin = m_pos;
+        idx = 0;
+        while (m_pos < m_src.size() && std::isdigit(charAt(m_pos))) {
+            idx = idx * 10 + static_cast<uint32_t>(m_src[m_pos] - '0');
+            m_pos++;
+            if (idx >= 32)
+                return fail("Invalid register");
+        }
+        return m_pos != begin || fail("Invalid register");
+    }
+
+    bool parsePrimary()
+    {
+        skipSpace();
+
+        if (accept("(")) {
+            if (not parseOr())
+                return false;
+            return accept(")") || fail("Expected ')'");
+        }
+
+        bool mem = accept("mem["), fmem = not mem && accept("fmem[");
+        if (mem || fmem) {
+            auto op = fmem ? Op::FMem : Op::Mem;
+            if (not parseOr())
+                return false;
+            if (not accept("]"))
+                return fail("Expected ']'");
+            emit(op, 1);
+            return true;
+        }
+
+        if (accept("cnt")) {
+            emit(Op::Cnt, 0);
+            return true;
+        }
+        if (accept("pc")) {
+            emit(Op::PC, 0);
+            return true;
+        }
+
+        if (m_pos < m_src.size()
+            && (m_src[m_pos] == 'r' || m_src[m_pos] == 'f')) {
+            auto op = m_src[m_pos] == 'r' ? Op::Reg : Op::FReg;
+            m_pos++;
+            uint32_t idx;
+            if (not parseRegIndex(idx))
+                return false;
+            emit(op, 0, idx);
+            return true;
+        }
+
+        if (m_pos < m_src.size()
+            && (std::isdigit(charAt(m_pos)) || m_src[m_pos] == '.')) {
+            const char* begin = m_src.c_str() + m_pos;
+            char* end;
+            double value = std::strtod(begin, &end);  // also takes "0x..."
+            m_pos += static_cast<size_t>(end - begin);
+            emit(Op::Const, 0, 0, value);
+            return true;
+        }
+
+        return fail("Expected a value");
+    }
+};
+
+bool Condition::compile(
+    const std::string& src, Condition& cond, std::string& error)
+{
+    Condition c;
+    c.m_source = src;
+    if (not Parser{c.m_source, c.m_code}.parse(error, c.m_stack_size))
+        return false;
+
+    cond = std::move(c);
+    return true;
+}
+
+static bool truth(double x) { return x < 0 || x > 0; }  // NaN is false
+
+bool Condition::eval(const Context& ctx) const
+{
+    constexpr size_t STACK_NUM = 64;
+    double fixed_stack[STACK_NUM];
+    std::vector<double> large_stack;
+    double* stack = fixed_stack;
+    if (m_stack_size > STACK_NUM) {
+        large_stack.resize(m_stack_size);
+        stack = large_stack.data();
+    }
+
+    bool invalid = false;
+    auto readMem = [&ctx, &invalid](double idx, bool as_float) {
+        if (not(idx >= 0 && idx < static_cast<double>(ctx.memory_num))) {
+            invalid = true;
+            return 0.0;
+        }
+
+        auto word = ctx.memory[static_cast<size_t>(idx)];
+        if (not as_float)
+            return static_cast<double>(word);
+        float f;
+        std::memcpy(&f, &word, sizeof f);
+        return static_cast<double>(f);
+    };
+
+    size_t sp = 0;
+    for (const auto& c : m_code) {
+        switch (c.op) {
+        case Op::Const:
+            stack[sp++] = c.value;
+            break;
+        case Op::Reg:
+            stack[sp++] = ctx.reg[c.idx];
+            break;
+        case Op::FReg:
+            stack[sp++] = ctx.freg[c.idx];
+            break;
+        case Op::Mem:
+            stack[sp - 1] = readMem(stack[sp - 1], false);
+            break;
+        case Op::FMem:
+            stack[sp - 1] = readMem(stack[sp - 1], true);
+            break;
+        case Op::Cnt:
+            stack[sp++] = static_cast<double>(ctx.inst_cnt);
+            break;
+        case Op::PC:
+            stack[sp++] = ctx.pc;
+            break;
+        case Op::Neg:
+            stack[sp - 1] = -stack[sp - 1];
+            break;
+        case Op::Not:
+            stack[sp - 1] = truth(stack[sp - 1]) ? 0 : 1;
+            break;
+        default: {
+            auto rhs = stack[--sp];
+            auto& lhs = stack[sp - 1];
+            switch (c.op) {
+            case Op::Add:
+                lhs += rhs;
+                break;
+            case Op::Sub:
+                lhs -= rhs;
+                break;
+            case Op::Mul:
+                lhs *= rhs;
+                break;
+            case Op::Div:
+                lhs /= rhs;
+                break;
+            case Op::Eq:
+                lhs = std::equal_to<double>{}(lhs, rhs);
+                break;
+            case Op::Ne:
+                lhs = not std::equal_to<double>{}(lhs, rhs);
+                break;
+            case Op::Lt:
+                lhs = lhs < rhs;
+                break;
+            case Op::Le:
+                lhs = lhs <= rhs;
+                break;
+            case Op::Gt:
+                lhs = lhs > rhs;
+                break;
+            case Op::Ge:
+                lhs = lhs >= rhs;
+                break;
+            case Op::And:
+                lhs = truth(lhs) && truth(rhs);
+                break;
+            case Op::Or:
+                lhs = truth(lhs) || truth(rhs);
+                break;
+            default:
+                break;
+            }
+        }
+        }
+    }
+
+    return not invalid && sp == 1 && truth(stack[0]);
+}
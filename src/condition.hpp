@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Breakpoint condition.
+ * An expression over registers, memory and the instruction count is
+ * compiled into a stack machine code once, and evaluated on each hit.
+ *
+ * expr    := or
+ * or      := and ("||" and)*
+ * and     := not ("&&" not)*
+ * not     := "!" not | cmp
+ * cmp     := sum (("==" | "!=" | "<" | "<=" | ">" | ">=") sum)?
+ * sum     := term (("+" | "-") term)*
+ * term    := unary (("*" | "/") unary)*
+ * unary   := "-" unary | primary
+ * primary := number | "r"N | "f"N | "mem[" expr "]" | "fmem[" expr "]"
+ *          | "cnt" | "pc" | "(" expr ")"
+ *
+ * Values are double. "mem" reads a word as an integer, "fmem" as a float.
+ * A condition reading memory out of range is false.
+ */
+class Condition
+{
+public:
+    struct Context {
+        const int32_t* reg;
+        const float* freg;
+        const int32_t* memory;
+        size_t memory_num;
+        int64_t inst_cnt;
+        uint32_t pc;
+    };
+
+    // Returns false and sets 'error' if 'src' is invalid
+    static bool compile(
+        const std::string& src, Condition& cond, std::string& error);
+
+    bool empty() const { return m_code.empty(); }
+    const std::string& source() const { return m_source; }
+
+    bool eval(const Context&) const;
+
+private:
+    enum class Op : uint8_t {
+        Const,
+        Reg,
+        FReg,
+        Mem,   // pop index
+        FMem,  // pop index
+        Cnt,
+        PC,
+        Neg,
+        Not,
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Eq,
+        Ne,
+        Lt,
+        Le,
+        Gt,
+        Ge,
+        And,
+        Or,
+    };
+
+    struct Code {
+        Op op;
+        uint32_t idx;  // register index
+        double value;  // constant
+    };
+
+    std::string m_source;
+    std::vector<Code> m_code;
+    size_t m_stack_size = 0;
+
+    class Parser;
+};
@@ -1,31 +1,56 @@
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 #include "simulator.hpp"
 #include "util.hpp"
 
-std::string Simulator::disasm(Simulator::Instruction inst) const
+const Simulator::MnemonicTable& Simulator::mnemonicTable()
+{
+    static const MnemonicTable table = makeMnemonicTable();
+    return table;
+}
+
+// Append formatted text to 'buf', truncating at 'size'
+static void appendf(
+    char* buf, size_t size, size_t& len, const char* fmt, ...)
+{
+    if (len >= size)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    auto n = std::vsnprintf(buf + len, size - len, fmt, args);
+    va_end(args);
+    len += n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+int Simulator::disasm(Simulator::Instruction inst, char* buf, size_t size)
 {
     using Field = Mnemonic::OperandField;
 
     auto opcode = decodeOpCode(inst);
-    if (m_mnemonic_table.count(opcode) == 0)
-        return "";
+    const auto& table = mnemonicTable();
+    auto it = table.find(opcode);
+    if (it == table.end()) {
+        buf[0] = '\0';
+        return 0;
+    }
 
-    auto mnemo = m_mnemonic_table.at(opcode);
+    const auto& mnemo = it->second;
 
-    std::ostringstream oss;
-    oss << std::setw(7) << mnemo.mnemonic;
+    size_t len = 0;
+    appendf(buf, size, len, "%7s", mnemo.mnemonic);
 
-    auto writeR = [&](Field f, const int32_t& r) {
+    auto writeR = [&](Field f, uint32_t r) {
         switch (f) {
         case Field::R:
-            oss << " r" << std::setw(2) << std::left << r;
+            appendf(buf, size, len, " r%-2u", r);
             return;
         case Field::F:
-            oss << " f" << std::setw(2) << std::left << r;
+            appendf(buf, size, len, " f%-2u", r);
             return;
         default:
-            oss << "  - ";
+            appendf(buf, size, len, "  - ");
             return;
         }
     };
@@ -38,9 +63,9 @@ std::string Simulator::disasm(Simulator::Instruction inst) const
         writeR(of[1], op.rt);
         writeR(of[2], op.rd);
         if (of[3] == Field::I)
-            oss << ' ' << op.shamt;
+            appendf(buf, size, len, " %u", op.shamt);
         else
-            oss << "  - ";
+            appendf(buf, size, len, "  - ");
         break;
     }
     case OperandType::I: {
@@ -50,21 +75,20 @@ std::string Simulator::disasm(Simulator::Instruction inst) const
 
         if (of[2] == Field::I) {
             auto imm_ext = static_cast<int32_t>(signExt(op.immediate, 16));
-            oss << ' ' << imm_ext
-                << "(0x" << std::hex << op.immediate << ')';
+            appendf(buf, size, len, " %d(0x%x)", imm_ext, op.immediate);
         } else {
-            oss << "  - ";
+            appendf(buf, size, len, "  - ");
         }
         break;
     }
     case OperandType::J: {
         auto op = decodeJ(inst);
-        oss << ' ' << op.addr;
+        appendf(buf, size, len, " %u", op.addr);
         break;
     }
     default:
         break;
     }
 
-    return oss.str();
+    return static_cast<int>(std::min(len, size - 1));
 }
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include "fpu.hpp"
+
+namespace fpu
+{
+
+namespace
+{
+
+constexpr uint32_t SIGN_MASK = 0x80000000;
+constexpr uint32_t EXP_MASK = 0x7f800000;
+constexpr uint32_t MANT_MASK = 0x007fffff;
+constexpr uint32_t INF = 0x7f800000;
+constexpr uint32_t NAN_ = 0x7fc00000;
+
+float toFloat(uint32_t u)
+{
+    float f;
+    std::memcpy(&f, &u, sizeof f);
+    return f;
+}
+
+uint32_t toBits(float f)
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof u);
+    return u;
+}
+
+uint32_t exponent(uint32_t a) { return (a & EXP_MASK) >> 23; }
+
+// Denormals to zero
+uint32_t flush(uint32_t a)
+{
+    return (a & EXP_MASK) == 0 ? (a & SIGN_MASK) : a;
+}
+
+/*
+ * Constant and gradient of each interval, scaled so that the mantissa of
+ * the result is computed in integer:
+ *   finv:  1 / 1.m * 2^24 = inv[i].c - ((d * inv[i].g) >> 16)
+ *   fsqrt: sqrt(u) * 2^23 = sqrt[i].c + ((d * sqrt[i].g) >> 17)
+ * where i is the table index and d is the rest of the mantissa.
+ * Each line is the tangent at the middle of the interval, shifted by half
+ * of its maximum error.
+ */
+constexpr int TABLE_BITS = 10;
+constexpr int TABLE_NUM = 1 << TABLE_BITS;
+
+struct Line {
+    uint32_t c;
+    uint32_t g;
+};
+
+struct Tables {
+    std::array<Line, TABLE_NUM> inv;
+    std::array<Line, TABLE_NUM> sqrt;
+};
+
+Tables makeTables()
+{
+    Tables t;
+
+    for (int i = 0; i < TABLE_NUM; i++) {
+        double a = 1.0 + i / 1024.0, h = 1.0 / 2048.0, xm = a + h;
+        double c = 1 / xm + h / (xm * xm) + h * h / (2 * xm * xm * xm);
+        t.inv[i].c = static_cast<uint32_t>(std::lround(std::ldexp(c, 24)));
+        t.inv[i].g = static_cast<uint32_t>(std::lround(std::ldexp(1 / (xm * xm), 17)));
+    }
+
+    for (int i = 0; i < TABLE_NUM; i++) {
+        bool odd = i >= TABLE_NUM / 2;  // u in [2, 4)
+        double w = odd ? 1.0 / 256 : 1.0 / 512;
+        double a = odd ? 2.0 + (i - TABLE_NUM / 2) * w : 1.0 + i * w;
+        double h = w / 2, xm = a + h, s = std::sqrt(xm);
+        double c = s - h / (2 * s) - h * h / (16 * xm * s);
+        double g = 1 / (2 * s) * (odd ? 2 : 1);
+        t.sqrt[i].c = static_cast<uint32_t>(std::lround(std::ldexp(c, 23)));
+        t.sqrt[i].g = static_cast<uint32_t>(std::lround(std::ldexp(g, 17)));
+    }
+
+    return t;
+}
+
+const Tables s_tables = makeTables();
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BATCH __attribute__((target_clones("avx2", "default")))
+#else
+#define BATCH
+#endif
+
+}  // namespace
+
+uint32_t fadd(uint32_t a, uint32_t b)
+{
+    return flush(toBits(toFloat(flush(a)) + toFloat(flush(b))));
+}
+
+uint32_t fsub(uint32_t a, uint32_t b) { return fadd(a, b ^ SIGN_MASK); }
+
+uint32_t fmul(uint32_t a, uint32_t b)
+{
+    uint32_t sign = (a ^ b) & SIGN_MASK;
+    auto ea = exponent(a), eb = exponent(b);
+    if (ea == 255 || eb == 255)
+        return toBits(toFloat(flush(a)) * toFloat(flush(b)));
+    if (ea == 0 || eb == 0)
+        return sign;
+
+    uint64_t ma = (a & MANT_MASK) | 0x800000, mb = (b & MANT_MASK) | 0x800000;
+    uint64_t p = ma * mb;  // [2^46, 2^48)
+
+    // round half up at the last place of the result
+    auto e = static_cast<int32_t>(ea + eb) - 127;
+    uint64_t m;
+    if (p & (1ull << 47)) {
+        m = (p + (1ull << 23)) >> 24;
+        e++;
+    } else {
+        m = (p + (1ull << 22)) >> 23;
+    }
+    if (m & (1u << 24)) {
+        m >>= 1;
+        e++;
+    }
+
+    if (e <= 0)
+        return sign;
+    if (e >= 255)
+        return sign | INF;
+    return sign | static_cast<uint32_t>(e) << 23
+           | (static_cast<uint32_t>(m) & MANT_MASK);
+}
+
+uint32_t finv(uint32_t a)
+{
+    uint32_t sign = a & SIGN_MASK;
+    auto e = exponent(a);
+    if (e == 0)
+        return sign | INF;
+    if (e == 255)
+        return (a & MANT_MASK) != 0 ? a : sign;
+
+    uint32_t m = a & MANT_MASK;
+    const auto& line = s_tables.inv[m >> 13];
+    uint32_t y = line.c - (((m & 0x1fff) * line.g) >> 16);  // [2^23, 2^24]
+    if (y < (1u << 23))
+        y = 1u << 23;
+
+    auto ne = static_cast<int32_t>(253 - e);
+    if (y >= (1u << 24)) {
+        y = 0;
+        ne++;
+    }
+
+    if (ne <= 0)
+        return sign;
+    return sign | static_cast<uint32_t>(ne) << 23 | (y & MANT_MASK);
+}
+
+uint32_t fdiv(uint32_t a, uint32_t b) { return fmul(a, finv(b)); }
+
+uint32_t fsqrt(uint32_t a)
+{
+    auto e = exponent(a);
+    if (e == 0)
+        return a & SIGN_MASK;
+    if (a & SIGN_MASK)
+        return NAN_;
+    if (e == 255)
+        return a;
+
+    auto unbiased = static_cast<int32_t>(e) - 127;
+    uint32_t odd = static_cast<uint32_t>(unbiased) & 1;
+    uint32_t m = a & MANT_MASK;
+    const auto& line = s_tables.sqrt[odd << 9 | m >> 14];
+    uint32_t y = line.c + (((m & 0x3fff) * line.g) >> 17);  // [2^23, 2^24)
+    if (y >= (1u << 24))
+        y = (1u << 24) - 1;
+
+    auto ne = (unbiased - static_cast<int32_t>(odd)) / 2 + 127;
+    return static_cast<uint32_t>(ne) << 23 | (y & MANT_MASK);
+}
+
+uint32_t itof(int32_t i) { return toBits(static_cast<float>(i)); }
+
+int32_t ftoi(uint32_t a)
+{
+    auto e = static_cast<int32_t>(exponent(a));
+    if (e < 126)
+        return 0;
+
+    uint32_t m = (a & MANT_MASK) | 0x800000;
+    int32_t shift = e - 150;
+    uint32_t r;
+    if (shift >= 8)
+        r = 0x80000000;  // out of range
+    else if (shift >= 0)
+        r = m << shift;
+    else
+        r = (m + (1u << (-shift - 1))) >> -shift;
+
+    return static_cast<int32_t>(a & SIGN_MASK ? 0u - r : r);
+}
+
+/*
+ * The batch forms compute every case of the scalar ones and select the
+ * result, in the reverse order of the early returns there.
+ */
+BATCH void fadd(const uint32_t* a, const uint32_t* b, uint32_t* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = flush(toBits(toFloat(flush(a[i])) + toFloat(flush(b[i]))));
+}
+
+BATCH void fsub(const uint32_t* a, const uint32_t* b, uint32_t* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = flush(toBits(toFloat(flush(a[i])) + toFloat(flush(b[i] ^ SIGN_MASK))));
+}
+
+BATCH void fmul(const uint32_t* a, const uint32_t* b, uint32_t* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = a[i], y = b[i];
+        uint32_t sign = (x ^ y) & SIGN_MASK;
+        auto ea = exponent(x), eb = exponent(y);
+
+        uint64_t ma = (x & MANT_MASK) | 0x800000, mb = (y & MANT_MASK) | 0x800000;
+        uint64_t p = ma * mb;
+        auto high = static_cast<uint32_t>(p >> 47);
+        uint64_t m = ((p >> high) + (1ull << 22)) >> 23;
+        auto carry = static_cast<uint32_t>(m >> 24);
+        m >>= carry;
+        auto e = static_cast<int32_t>(ea + eb + high + carry) - 127;
+
+        uint32_t r = sign | static_cast<uint32_t>(e) << 23
+                     | (static_cast<uint32_t>(m) & MANT_MASK);
+        r = e >= 255 ? sign | INF : r;
+        r = e <= 0 ? sign : r;
+        out[i] = (ea == 0) | (eb == 0) ? sign : r;
+    }
+
+    // Apart, since the float multiplication stops the loop above from being
+    // vectorized
+    for (size_t i = 0; i < n; i++)
+        if ((exponent(a[i]) == 255) | (exponent(b[i]) == 255))
+            out[i] = toBits(toFloat(flush(a[i])) * toFloat(flush(b[i])));
+}
+
+BATCH void finv(const uint32_t* a, uint32_t* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = a[i];
+        uint32_t sign = x & SIGN_MASK;
+        auto e = exponent(x);
+        uint32_t m = x & MANT_MASK;
+
+        const auto& line = s_tables.inv[m >> 13];
+        uint32_t y = line.c - (((m & 0x1fff) * line.g) >> 16);
+        y = y < (1u << 23) ? 1u << 23 : y;
+        uint32_t carry = y >> 24;
+        y = carry != 0 ? 0 : y;
+        auto ne = static_cast<int32_t>(253 + carry - e);
+
+        uint32_t r = sign | static_cast<uint32_t>(ne) << 23 | (y & MANT_MASK);
+        r = ne <= 0 ? sign : r;
+        r = e == 255 ? (m != 0 ? x : sign) : r;
+        out[i] = e == 0 ? sign | INF : r;
+    }
+}
+
+void fdiv(const uint32_t* a, const uint32_t* b, uint32_t* __restrict out, size_t n)
+{
+    constexpr size_t BLOCK_SIZE = 1024;
+    uint32_t inv[BLOCK_SIZE];
+    for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+        size_t k = std::min(BLOCK_SIZE, n - i);
+        finv(b + i, inv, k);
+        fmul(a + i, inv, out + i, k);
+    }
+}
+
+BATCH void fsqrt(const uint32_t* a, uint32_t* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = a[i];
+        auto e = exponent(x);
+        auto unbiased = static_cast<int32_t>(e) - 127;
+        uint32_t odd = static_cast<uint32_t>(unbiased) & 1;
+        uint32_t m = x & MANT_MASK;
+
+        const auto& line = s_tables.sqrt[odd << 9 | m >> 14];
+        uint32_t y = line.c + (((m & 0x3fff) * line.g) >> 17);
+        y = y >= (1u << 24) ? (1u << 24) - 1 : y;
+        auto ne = (unbiased - static_cast<int32_t>(odd)) / 2 + 127;
+
+        uint32_t r = static_cast<uint32_t>(ne) << 23 | (y & MANT_MASK);
+        r = e == 255 ? x : r;
+        r = x & SIGN_MASK ? NAN_ : r;
+        out[i] = e == 0 ? x & SIGN_MASK : r;
+    }
+}
+
+BATCH void itof(const uint32_t* a, uint32_t* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = toBits(static_cast<float>(static_cast<int32_t>(a[i])));
+}
+
+BATCH void ftoi(const uint32_t* a, uint32_t* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = a[i];
+        auto e = static_cast<int32_t>(exponent(x));
+        uint32_t m = (x & MANT_MASK) | 0x800000;
+        int32_t shift = e - 150;
+
+        // the right shift is taken only for shift in [-24, 0)
+        auto down = static_cast<uint32_t>(std::min(std::max(-shift, 1), 24));
+        uint32_t r = (m + (1u << (down - 1))) >> down;
+        r = shift >= 0 ? m << (static_cast<uint32_t>(shift) & 7) : r;
+        r = shift >= 8 ? 0x80000000 : r;
+        r = e < 126 ? 0 : r;
+        out[i] = x & SIGN_MASK ? 0u - r : r;
+    }
+}
+
+}  // namespace fpu
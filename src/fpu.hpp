@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Provisional model of the FELIS hardware FPU.
+ * The tables and the rounding below are not taken from the FPU design and
+ * have not been validated against the board, so results may differ from it
+ * bit for bit. Only makeTables() and the rounding need to follow the design
+ * once it is available. Until then it is used only by tools/fpu_verify.cpp,
+ * and can't be selected from the command line.
+ * Operands and results are IEEE 754 single precision bit patterns.
+ *
+ * - Denormal inputs are read as zero, and results below the normal range
+ *   are flushed to zero with the sign kept.
+ * - fadd rounds to nearest even, as the adder does.
+ * - fmul rounds half up (away from zero), not to nearest even.
+ * - finv approximates 1 / 1.m by a line on each of 1024 intervals chosen by
+ *   the upper 10 bits of the mantissa. fdiv(a, b) is fmul(a, finv(b)).
+ * - fsqrt does the same on 1024 intervals chosen by the exponent parity
+ *   and the upper 9 bits of the mantissa.
+ * - itof rounds to nearest even. ftoi rounds half away from zero.
+ *
+ * finv and fsqrt read a constant and a gradient from tables built once at
+ * startup, and the rest is integer arithmetic.
+ *
+ * The batch forms compute out[i] from a[i] (and b[i]) for i < n, bit for
+ * bit as the scalar ones do. They are written without branches so that the
+ * loops are vectorized, and on x86-64 a copy built for AVX2 is chosen when
+ * the CPU has it. out must not overlap a or b. itof reads and ftoi writes
+ * the bit patterns of int32.
+ */
+namespace fpu
+{
+
+uint32_t fadd(uint32_t a, uint32_t b);
+uint32_t fsub(uint32_t a, uint32_t b);
+uint32_t fmul(uint32_t a, uint32_t b);
+uint32_t finv(uint32_t a);
+uint32_t fdiv(uint32_t a, uint32_t b);
+uint32_t fsqrt(uint32_t a);
+
+uint32_t itof(int32_t i);
+int32_t ftoi(uint32_t a);
+
+void fadd(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n);
+void fsub(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n);
+void fmul(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n);
+void finv(const uint32_t* a, uint32_t* out, size_t n);
+void fdiv(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n);
+void fsqrt(const uint32_t* a, uint32_t* out, size_t n);
+void itof(const uint32_t* a, uint32_t* out, size_t n);
+void ftoi(const uint32_t* a, uint32_t* out, size_t n);
+
+}  // namespace fpu
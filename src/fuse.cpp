@@ -0,0 +1,21 @@
+#include "simulator.hpp"
+
+std::vector<Simulator::FusedOp> Simulator::fuse(
+    const std::vector<OpCode>& opcodes)
+{
+    std::vector<FusedOp> fused(opcodes.size(), FusedOp::NONE);
+
+    for (size_t idx = 0; idx + 1 < opcodes.size(); idx++) {
+        auto op1 = opcodes[idx], op2 = opcodes[idx + 1];
+
+#define FUSED_PAIR_MATCH(a, b, first, second) \
+    if (op1 == OpCode::a && op2 == OpCode::b) \
+        fused[idx] = FusedOp::a##_##b;
+
+        FELIS_SIM_FOR_EACH_FUSED_PAIR(FUSED_PAIR_MATCH)
+
+#undef FUSED_PAIR_MATCH
+    }
+
+    return fused;
+}
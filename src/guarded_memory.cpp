@@ -0,0 +1,110 @@
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "util.hpp"
+#include "guarded_memory.hpp"
+
+thread_local GuardedMemory* GuardedMemory::s_active = nullptr;
+
+GuardedMemory::GuardedMemory(size_t word_num, const uint32_t* pc) : m_pc(pc)
+{
+    static std::once_flag handler_installed;
+    std::call_once(handler_installed, []() {
+        struct sigaction sa;
+        sa.sa_sigaction = onSignal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_SIGINFO;
+        if (sigaction(SIGSEGV, &sa, nullptr) != 0)
+            FAIL("# Error: Couldn't install SIGSEGV handler");
+    });
+
+    if (s_active != nullptr)
+        FAIL("# Error: Guarded memory is already used in this thread");
+
+    auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto word_size = word_num * sizeof(int32_t);
+    auto mapped_size = (word_size + page_size - 1) / page_size * page_size;
+    constexpr size_t GUARD_SIZE = (size_t{1} << 32) * sizeof(int32_t);
+
+    m_map_size = mapped_size + GUARD_SIZE;
+    m_words_size = mapped_size;
+    m_map = mmap(nullptr, m_map_size, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (m_map == MAP_FAILED)
+        FAIL("# Error: Memory couldn't mmap'ed");
+    if (mapped_size > 0
+        && mprotect(m_map, mapped_size, PROT_READ | PROT_WRITE) != 0)
+        FAIL("# Error: Memory couldn't mprotect'ed");
+
+    m_words = reinterpret_cast<int32_t*>(
+        static_cast<char*>(m_map) + (mapped_size - word_size));
+
+    s_active = this;
+}
+
+GuardedMemory::~GuardedMemory()
+{
+    munmap(m_map, m_map_size);
+    s_active = nullptr;
+}
+
+size_t GuardedMemory::residentSize() const
+{
+    auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> resident(m_words_size / page_size);
+    if (resident.empty() || mincore(m_map, m_words_size, resident.data()) != 0)
+        return 0;
+
+    size_t pages = 0;
+    for (auto r : resident)
+        pages += r & 1;
+    return pages * page_size;
+}
+
+void GuardedMemory::onSignal(int, siginfo_t* info, void*)
+{
+    auto memory = s_active;
+    auto addr = static_cast<char*>(info->si_addr);
+    auto begin = memory == nullptr ? nullptr : static_cast<char*>(memory->m_map);
+    if (memory == nullptr || addr < begin || addr >= begin + memory->m_map_size) {
+        signal(SIGSEGV, SIG_DFL);  // not ours: fault again and crash
+        return;
+    }
+
+    // Sign-extended in the report, as checkMemoryIndex did
+    auto idx = static_cast<uint32_t>(
+        (addr - reinterpret_cast<char*>(memory->m_words)) / sizeof(int32_t));
+    if (memory->m_running) {
+        memory->m_fault_idx = idx;
+        memory->m_fault_pc = *memory->m_pc;
+        siglongjmp(memory->m_fault_jump, 1);
+    }
+
+    // Not in run(): report with only async-signal-safe calls
+    char msg[96];
+    size_t len = 0;
+    auto append = [&msg, &len](const char* str) {
+        while (*str != '\0' && len < sizeof msg)
+            msg[len++] = *str++;
+    };
+    auto appendNum = [&append](uint64_t n) {
+        char digits[24];
+        auto p = digits + sizeof digits;
+        *--p = '\0';
+        do {
+            *--p = static_cast<char>('0' + n % 10);
+            n /= 10;
+        } while (n > 0);
+        append(p);
+    };
+    append("# Error: Memory index out of range: ");
+    appendNum(static_cast<size_t>(static_cast<int32_t>(idx)));
+    append(" at PC ");
+    appendNum(*memory->m_pc);
+    append("\n");
+    auto written = write(STDERR_FILENO, msg, len);
+    (void)written;
+    _exit(1);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <csignal>
+#include <csetjmp>
+#include <iostream>
+#include "util.hpp"
+
+/*
+ * Simulated memory followed by a guard region.
+ * The words are placed so that they end at a page boundary, and the whole
+ * range reachable by a 32 bit index after them is mapped PROT_NONE.
+ * Indexing with an out-of-range uint32_t faults instead of a compare on
+ * every access. The SIGSEGV handler jumps back to run(), which reports the
+ * index and the PC pointed by 'pc' with FAIL.
+ * The memory is bound to the constructing thread.
+ */
+class GuardedMemory
+{
+public:
+    GuardedMemory(size_t word_num, const uint32_t* pc);
+    ~GuardedMemory();
+
+    GuardedMemory(const GuardedMemory&) = delete;
+    GuardedMemory& operator=(const GuardedMemory&) = delete;
+
+    int32_t* data() const { return m_words; }
+
+    // Bytes of the words backed by physical pages, i.e. touched
+    size_t residentSize() const;
+
+    // Call 'f', failing on a fault on the guard region. The frames of 'f'
+    // are left with siglongjmp, so they must not own anything.
+    template <class F>
+    void run(F f)
+    {
+        if (sigsetjmp(m_fault_jump, 1) == 0) {
+            m_running = true;
+            try {
+                f();
+            } catch (...) {
+                m_running = false;
+                throw;
+            }
+            m_running = false;
+            return;
+        }
+        m_running = false;
+        FAIL("# Error: Memory index out of range: "
+             << static_cast<size_t>(static_cast<int32_t>(m_fault_idx))
+             << " at PC " << m_fault_pc);
+    }
+
+private:
+    const uint32_t* const m_pc;
+
+    void* m_map;
+    size_t m_map_size;
+    size_t m_words_size;  // mapped readable and writable
+    int32_t* m_words;
+
+    sigjmp_buf m_fault_jump;
+    volatile sig_atomic_t m_running = false;  // in run()
+    uint32_t m_fault_idx;
+    uint32_t m_fault_pc;
+
+    static thread_local GuardedMemory* s_active;
+    static void onSignal(int, siginfo_t*, void*);
+};
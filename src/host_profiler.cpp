@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "util.hpp"
+#include "host_profiler.hpp"
+
+HostProfiler* HostProfiler::s_active = nullptr;
+
+namespace
+{
+
+const char* const PHASE_NAMES[HostProfiler::PHASE_NUM]
+    = {"other", "load", "execute", "stats", "ui"};
+
+#if defined(__x86_64__) || defined(__i386__)
+inline uint64_t rdpmc(uint32_t counter)
+{
+    uint32_t lo, hi;
+    asm volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+    return lo | static_cast<uint64_t>(hi) << 32;
+}
+#endif
+
+double ratio(uint64_t a, uint64_t b)
+{
+    return b > 0 ? static_cast<double>(a) / static_cast<double>(b) : 0.0;
+}
+
+}  // namespace
+
+HostProfiler::HostProfiler(bool handlers) : m_handlers(handlers)
+{
+    if (s_active != nullptr)
+        FAIL("# Error: Host profiler is already running");
+
+    static const uint64_t HARDWARE[EVENT_NUM]
+        = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+    for (auto config : HARDWARE) {
+        if (not open(PERF_TYPE_HARDWARE, config)) {
+            m_hardware = false;
+            break;
+        }
+    }
+
+    if (m_hardware) {
+        auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        for (auto fd : m_fds) {
+            auto p = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                m_pages.clear();
+                break;
+            }
+            m_pages.emplace_back(p);
+        }
+    } else {
+        for (auto fd : m_fds)
+            close(fd);
+        m_fds.clear();
+        if (not open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK))
+            FAIL("# Error: perf_event_open failed: " << strerror(errno));
+    }
+
+    s_active = this;
+    m_last = read();
+}
+
+HostProfiler::~HostProfiler()
+{
+    auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for (auto p : m_pages)
+        munmap(const_cast<void*>(p), page_size);
+    for (auto fd : m_fds)
+        close(fd);
+
+    s_active = nullptr;
+}
+
+bool HostProfiler::open(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr = {};
+    attr.size = sizeof attr;
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.pinned = m_fds.empty();  // never multiplexed, so rdpmc matches read()
+
+    auto group = m_fds.empty() ? -1 : m_fds.front();
+    auto fd = static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    if (fd < 0)
+        return false;
+    m_fds.emplace_back(fd);
+    return true;
+}
+
+// The sequence of perf_event_mmap_page, false if rdpmc can't be used now
+bool HostProfiler::readMapped(Sample& s) const
+{
+#if defined(__x86_64__) || defined(__i386__)
+    for (size_t i = 0; i < m_pages.size(); i++) {
+        auto pc
+            = static_cast<const volatile perf_event_mmap_page*>(m_pages[i]);
+        uint32_t seq;
+        do {
+            seq = pc->lock;
+            asm volatile("" ::: "memory");
+            auto index = pc->index;
+            if (not pc->cap_user_rdpmc || index == 0)
+                return false;
+            auto shift = 64 - pc->pmc_width;
+            auto pmc
+                = static_cast<int64_t>(rdpmc(index - 1) << shift) >> shift;
+            s[i] = static_cast<uint64_t>(pc->offset + pmc);
+            asm volatile("" ::: "memory");
+        } while (pc->lock != seq);
+    }
+    return true;
+#else
+    (void)s;
+    return false;
+#endif
+}
+
+HostProfiler::Sample HostProfiler::read() const
+{
+    Sample s{};
+    if (not m_pages.empty() && readMapped(s))
+        return s;
+
+    uint64_t buf[1 + EVENT_NUM];
+    if (::read(m_fds.front(), buf, sizeof buf) < 8)
+        FAIL("# Error: Host counters couldn't be read");
+    for (uint64_t i = 0; i < buf[0] && i < EVENT_NUM; i++)
+        s[i] = buf[1 + i];
+    return s;
+}
+
+HostProfiler::Phase HostProfiler::enter(Phase phase)
+{
+    auto now = read();
+    for (int e = 0; e < EVENT_NUM; e++)
+        m_phases[m_phase][e] += now[e] - m_last[e];
+    m_last = now;
+
+    auto prev = m_phase;
+    m_phase = phase;
+    return prev;
+}
+
+HostProfiler::Scope::Scope(Phase phase)
+    : m_prev(s_active != nullptr ? s_active->enter(phase) : OTHER)
+{
+}
+
+HostProfiler::Scope::~Scope()
+{
+    if (s_active != nullptr)
+        s_active->enter(m_prev);
+}
+
+void HostProfiler::setHandlerNames(const std::vector<std::string>& names)
+{
+    m_names = names;
+    m_handler.assign(names.size(), Sample{});
+    m_handler_cnt.assign(names.size(), 0);
+
+    // The least counts between two reads, as the cost of measuring
+    constexpr int CALIBRATION_NUM = 1000;
+    m_overhead.fill(std::numeric_limits<uint64_t>::max());
+    for (int i = 0; i < CALIBRATION_NUM; i++) {
+        auto before = read();
+        auto after = read();
+        for (int e = 0; e < EVENT_NUM; e++)
+            m_overhead[e] = std::min(m_overhead[e], after[e] - before[e]);
+    }
+}
+
+void HostProfiler::print()
+{
+    enter(m_phase);
+
+    if (m_hardware) {
+        fprintf(stderr, "# Host counters (user space)\n");
+        fprintf(stderr, "%-10s %16s %16s %6s %14s %14s\n", "phase", "cycles",
+            "instructions", "IPC", "branch-misses", "cache-misses");
+    } else {
+        fprintf(stderr, "# Host counters: no hardware PMU, task clock only\n");
+        fprintf(stderr, "%-10s %16s\n", "phase", "task-clock(ns)");
+    }
+    for (int p = 0; p < PHASE_NUM; p++) {
+        const auto& c = m_phases[p];
+        if (c[CYCLES] == 0)
+            continue;
+        if (m_hardware)
+            fprintf(stderr,
+                "%-10s %16" PRIu64 " %16" PRIu64 " %6.2f %14" PRIu64
+                " %14" PRIu64 "\n",
+                PHASE_NAMES[p], c[CYCLES], c[INSTRUCTIONS],
+                ratio(c[INSTRUCTIONS], c[CYCLES]), c[BRANCH_MISSES],
+                c[CACHE_MISSES]);
+        else
+            fprintf(
+                stderr, "%-10s %16" PRIu64 "\n", PHASE_NAMES[p], c[CYCLES]);
+    }
+
+    if (not m_handlers || m_names.empty())
+        return;
+
+    // The rest of the execute phase is the loop: fetch, dispatch, counting
+    // and the profilers, with the part of the measurement outside handlers
+    Sample dispatch = m_phases[EXECUTE];
+    int64_t inst_num = 0;
+    std::vector<size_t> order;
+    for (size_t i = 0; i < m_names.size(); i++) {
+        if (m_handler_cnt[i] == 0)
+            continue;
+        order.emplace_back(i);
+        inst_num += m_handler_cnt[i];
+        for (int e = 0; e < EVENT_NUM; e++)
+            dispatch[e] -= std::min(dispatch[e], m_handler[i][e]);
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_handler[a][CYCLES] > m_handler[b][CYCLES];
+    });
+
+    auto execute = m_phases[EXECUTE][CYCLES];
+    auto row = [&](const char* name, int64_t cnt, const Sample& c) {
+        auto n = static_cast<uint64_t>(cnt);
+        if (m_hardware)
+            fprintf(stderr,
+                "%-10s %14" PRId64 " %8.2f %8.2f %10.3f %10.3f %6.2f%%\n",
+                name, cnt, ratio(c[CYCLES], n), ratio(c[INSTRUCTIONS], n),
+                1000 * ratio(c[BRANCH_MISSES], n),
+                1000 * ratio(c[CACHE_MISSES], n),
+                100 * ratio(c[CYCLES], execute));
+        else
+            fprintf(stderr, "%-10s %14" PRId64 " %8.2f %6.2f%%\n", name, cnt,
+                ratio(c[CYCLES], n), 100 * ratio(c[CYCLES], execute));
+    };
+
+    fprintf(stderr,
+        "# Handlers, per instruction less the measurement overhead of %" PRIu64
+        " %s\n",
+        m_overhead[CYCLES], m_hardware ? "cycles" : "ns");
+    if (m_hardware)
+        fprintf(stderr, "%-10s %14s %8s %8s %10s %10s %7s\n", "handler",
+            "count", "cycles", "insts", "br-miss/k", "$-miss/k", "share");
+    else
+        fprintf(stderr, "%-10s %14s %8s %7s\n", "handler", "count", "ns",
+            "share");
+    for (auto i : order)
+        row(m_names[i].c_str(), m_handler_cnt[i], m_handler[i]);
+    row("(loop)", inst_num, dispatch);
+}
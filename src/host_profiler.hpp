@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Self-profiler with the host hardware counters (perf_event_open, user
+ * space only), printed by print() at exit.
+ * The counts are attributed to the phase entered last with Scope, and
+ * with 'handlers', also to each instruction handler run by the headless
+ * loop. The counters are read with rdpmc where the kernel allows it, and
+ * with read() otherwise. Without a hardware PMU (e.g. in a VM), only the
+ * task clock is counted.
+ * Only one profiler can be active in a process, on the constructing thread.
+ */
+class HostProfiler
+{
+public:
+    enum Event { CYCLES, INSTRUCTIONS, BRANCH_MISSES, CACHE_MISSES, EVENT_NUM };
+    enum Phase { OTHER, LOAD, EXECUTE, STATS, UI, PHASE_NUM };
+    using Sample = std::array<uint64_t, EVENT_NUM>;
+
+    explicit HostProfiler(bool handlers);
+    ~HostProfiler();
+
+    HostProfiler(const HostProfiler&) = delete;
+    HostProfiler& operator=(const HostProfiler&) = delete;
+
+    static HostProfiler* active() { return s_active; }
+    bool handlers() const { return m_handlers; }
+
+    // Switch to 'phase' while alive, if a profiler is active
+    class Scope
+    {
+    public:
+        explicit Scope(Phase phase);
+        ~Scope();
+
+    private:
+        Phase m_prev;
+    };
+
+    Sample read() const;
+
+    // Names of the handlers, indexed as in addHandler()
+    void setHandlerNames(const std::vector<std::string>& names);
+    // Attribute the counts since 'before' to handler 'i'
+    void addHandler(size_t i, const Sample& before)
+    {
+        auto after = read();
+        auto& total = m_handler[i];
+        for (int e = 0; e < EVENT_NUM; e++) {
+            auto d = after[e] - before[e];
+            total[e] += d > m_overhead[e] ? d - m_overhead[e] : 0;
+        }
+        m_handler_cnt[i]++;
+    }
+
+    // Print the phases and the handlers to stderr
+    void print();
+
+private:
+    const bool m_handlers;
+    bool m_hardware = true;  // false: CYCLES is the task clock in ns
+    std::vector<int> m_fds;  // the group leader first
+    std::vector<const void*> m_pages;  // perf_event_mmap_page for rdpmc
+
+    Phase m_phase = OTHER;
+    Sample m_last{};
+    std::array<Sample, PHASE_NUM> m_phases{};
+    Phase enter(Phase phase);
+
+    std::vector<std::string> m_names;
+    std::vector<Sample> m_handler;
+    std::vector<int64_t> m_handler_cnt;
+    Sample m_overhead{};  // of a pair of read(), subtracted from each handler
+
+    bool open(uint32_t type, uint64_t config);
+    bool readMapped(Sample& s) const;
+
+    static HostProfiler* s_active;
+};
@@ -0,0 +1,147 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util.hpp"
+#include "simulator.hpp"
+
+/*
+ * Sectioned executable image, in the byte order of the host (little endian
+ * on x86):
+ *
+ *   char     magic[4] = "\x7f" "FEL"
+ *   uint32   version = 1
+ *   uint32   entry  (PC to start from, in bytes)
+ *   uint32   section_num
+ *   {uint32 type, uint32 addr, uint32 offset, uint32 size}[section_num]
+ *
+ * 'offset' and 'size' are in bytes from the start of the file. The types:
+ *
+ *   TEXT     the codes from PC 0, as in a raw .bin. Exactly one.
+ *   DATA     words loaded into the memory from the word index 'addr'
+ *   SYMBOLS  {uint32 value, char name[] NUL-terminated}[], labels in -d
+ *
+ * TEXT and DATA are aligned to 4 bytes. Any other file is a raw .bin.
+ * tools/mkimage.py makes one from a .bin and data files.
+ */
+namespace
+{
+
+constexpr uint32_t IMAGE_MAGIC = 0x4c45467f;
+constexpr uint32_t IMAGE_VERSION = 1;
+
+enum SectionType : uint32_t { SECTION_TEXT = 1, SECTION_DATA, SECTION_SYMBOLS };
+
+struct ImageHeader {
+    uint32_t magic, version, entry, section_num;
+};
+
+struct Section {
+    uint32_t type, addr, offset, size;
+};
+
+}  // namespace
+
+void Simulator::readImage(ProgramImage& image, const std::string& binfile)
+{
+    auto fd = ::open(binfile.c_str(), O_RDONLY);
+    if (fd < 0)
+        FAIL("# Error: File " << binfile << " couldn't be opened");
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        FAIL("# Error: File " << binfile << " couldn't be read");
+    auto size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        close(fd);
+        return;
+    }
+
+    auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        FAIL("# Error: File " << binfile << " couldn't be mapped");
+    std::shared_ptr<const void> mapping{
+        p, [size](const void* q) { munmap(const_cast<void*>(q), size); }};
+    auto bytes = static_cast<const char*>(p);
+
+    ImageHeader header = {};
+    if (size >= sizeof header)
+        std::memcpy(&header, bytes, sizeof header);
+    if (header.magic != IMAGE_MAGIC) {
+        // Raw .bin, where a partial last word is ignored
+        auto codes = reinterpret_cast<const Instruction*>(bytes);
+        image.codes.assign(codes, codes + size / sizeof(Instruction));
+        return;
+    }
+
+    if (header.version != IMAGE_VERSION)
+        FAIL("# Error: " << binfile << " is an image of unsupported version "
+                         << header.version);
+    if (sizeof header + sizeof(Section) * uint64_t{header.section_num} > size)
+        FAIL("# Error: Section table out of " << binfile);
+
+    bool text = false;
+    for (uint32_t i = 0; i < header.section_num; i++) {
+        Section sec;
+        std::memcpy(&sec, bytes + sizeof header + sizeof sec * i, sizeof sec);
+        if (uint64_t{sec.offset} + sec.size > size)
+            FAIL("# Error: Section " << i << " out of " << binfile);
+        if (sec.type != SECTION_SYMBOLS
+            && (sec.offset % 4 != 0 || sec.size % 4 != 0))
+            FAIL("# Error: Section " << i << " of " << binfile
+                                     << " not aligned to words");
+
+        auto begin = bytes + sec.offset;
+        auto end = begin + sec.size;
+        switch (sec.type) {
+        case SECTION_TEXT: {
+            if (text)
+                FAIL("# Error: Multiple text sections in " << binfile);
+            text = true;
+            auto codes = reinterpret_cast<const Instruction*>(begin);
+            image.codes.assign(codes, codes + sec.size / sizeof(Instruction));
+            break;
+        }
+        case SECTION_DATA:
+            image.data.push_back({sec.addr,
+                reinterpret_cast<const int32_t*>(begin), sec.size / 4});
+            break;
+        case SECTION_SYMBOLS:
+            while (begin < end) {
+                uint32_t value;
+                auto nul = end - begin > 4 ? static_cast<const char*>(
+                               std::memchr(begin + 4, '\0', end - begin - 4))
+                                           : nullptr;
+                if (nul == nullptr)
+                    FAIL("# Error: Broken symbol table in " << binfile);
+                std::memcpy(&value, begin, sizeof value);
+                image.symbols.emplace(value, std::string{begin + 4, nul});
+                begin = nul + 1;
+            }
+            break;
+        default:
+            FAIL("# Error: Unknown section type " << sec.type << " in "
+                                                  << binfile);
+        }
+    }
+
+    if (not text)
+        FAIL("# Error: No text section in " << binfile);
+    if (header.entry % 4 != 0 || header.entry / 4 >= image.codes.size())
+        FAIL("# Error: Entry point " << header.entry << " out of the text");
+    image.entry = header.entry;
+    if (not image.data.empty())
+        image.mapping = mapping;
+}
+
+// Start from the entry point, with the data segments in the memory
+void Simulator::loadSegments()
+{
+    m_pc = m_image->entry;
+    for (const auto& d : m_image->data) {
+        if (d.addr > m_memory_num || d.num > m_memory_num - d.addr)
+            FAIL("# Error: Data segment at " << d.addr << " out of memory");
+        std::memcpy(m_memory + d.addr, d.words, sizeof(int32_t) * d.num);
+    }
+}
@@ -0,0 +1,281 @@
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util.hpp"
+#include "simulator.hpp"
+
+/*
+ * Cache of the analysis of the codes in loadImage(), in a directory given
+ * with -C, named by the key in hex. In the byte order of the host:
+ *
+ *   char     magic[4] = "FSIC"
+ *   uint32   version = 3
+ *   uint64   key  (hash of the codes and the simulator executable)
+ *   uint32   code_num, loop_num, asm_text_size, reserved
+ *   uint64   checksum  (hash of the rest of the file)
+ *   uint32   opcodes[code_num], asm_offset[code_num]
+ *   int32    loop_of[code_num]
+ *   {uint32 header, uint32 latch, int32 parent}[loop_num]
+ *   uint8    pc_check[code_num], block_end[code_num], fused[code_num]
+ *   char     asm_text[asm_text_size]
+ *
+ * The arrays are laid out as in ProgramImage, so a hit maps the file and
+ * points the image at it without decoding, verification, fusion, loop
+ * detection or disassembly. Beyond the checksum, only the values the
+ * simulator indexes with are checked to be in range. A file failing them
+ * is a miss, and is written again.
+ */
+namespace
+{
+
+constexpr uint32_t CACHE_VERSION = 3;
+
+// As decodeOpCode() takes 6 bits
+constexpr uint32_t OPCODE_LIMIT = 1 << 6;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t code_num, loop_num, asm_text_size, reserved;
+    uint64_t checksum;
+};
+
+// FNV-1a on words
+uint64_t hashWords(uint64_t h, const uint32_t* words, size_t num)
+{
+    for (size_t i = 0; i < num; i++)
+        h = (h ^ words[i]) * 0x100000001b3;
+    return h;
+}
+
+// FNV-1a on 8-byte words, and on the bytes left
+uint64_t hashBytes(const char* bytes, size_t size)
+{
+    uint64_t h = 0xcbf29ce484222325;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof word);
+        h = (h ^ word) * 0x100000001b3;
+    }
+    for (; i < size; i++)
+        h = (h ^ static_cast<uint8_t>(bytes[i])) * 0x100000001b3;
+    return h;
+}
+
+// The codes, and the build of the simulator by its size and mtime. False if
+// the executable can't be read, as a rebuild then couldn't be told.
+bool cacheKey(const std::vector<uint32_t>& codes, uint64_t& key)
+{
+    struct stat st;
+    if (stat("/proc/self/exe", &st) != 0)
+        return false;
+    const uint32_t build[] = {CACHE_VERSION,
+        static_cast<uint32_t>(st.st_size),
+        static_cast<uint32_t>(st.st_mtim.tv_sec),
+        static_cast<uint32_t>(st.st_mtim.tv_nsec),
+        static_cast<uint32_t>(codes.size())};
+    key = hashWords(0xcbf29ce484222325, build, sizeof build / sizeof build[0]);
+    key = hashWords(key, codes.data(), codes.size());
+    return true;
+}
+
+std::string cachePath(const std::string& dir, uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof name, "/%016" PRIx64 ".cache", key);
+    return dir + name;
+}
+
+size_t cacheSize(const CacheHeader& h)
+{
+    return sizeof h + (4 + 4 + 4 + 1 + 1 + 1) * size_t{h.code_num}
+           + sizeof(Simulator::ProgramImage::Loop) * h.loop_num
+           + h.asm_text_size;
+}
+
+}  // namespace
+
+bool Simulator::loadCachedImage(ProgramImage& image, const std::string& dir)
+{
+    static_assert(sizeof(OpCode) == 4 && sizeof(FusedOp) == 1
+                      && sizeof(ProgramImage::Loop) == 12,
+        "the arrays are cached as is");
+
+    uint64_t key;
+    if (not cacheKey(image.codes, key))
+        return false;
+    auto fd = ::open(cachePath(dir, key).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0
+        && static_cast<size_t>(st.st_size) >= sizeof(CacheHeader))
+        p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+            MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    auto size = static_cast<size_t>(st.st_size);
+    std::shared_ptr<const void> mapping{
+        p, [size](const void* q) { munmap(const_cast<void*>(q), size); }};
+
+    CacheHeader h;
+    std::memcpy(&h, p, sizeof h);
+    if (std::memcmp(h.magic, "FSIC", 4) != 0 || h.version != CACHE_VERSION
+        || h.key != key || h.code_num != image.codes.size()
+        || cacheSize(h) != size
+        || hashBytes(static_cast<const char*>(p) + sizeof h, size - sizeof h)
+               != h.checksum)
+        return false;
+
+    // Every array is aligned to its elements, following the header
+    auto n = image.codes.size();
+    auto pos = static_cast<const char*>(p) + sizeof h;
+    auto take = [&pos](size_t bytes) {
+        auto q = pos;
+        pos += bytes;
+        return q;
+    };
+    image.opcodes = {reinterpret_cast<const OpCode*>(take(4 * n)), n};
+    image.asm_offset = {reinterpret_cast<const uint32_t*>(take(4 * n)), n};
+    image.loop_of = {reinterpret_cast<const int32_t*>(take(4 * n)), n};
+    image.loops = {reinterpret_cast<const ProgramImage::Loop*>(
+                       take(sizeof(ProgramImage::Loop) * h.loop_num)),
+        h.loop_num};
+    image.pc_check = {reinterpret_cast<const uint8_t*>(take(n)), n};
+    image.block_end = {reinterpret_cast<const uint8_t*>(take(n)), n};
+    image.fused = {reinterpret_cast<const FusedOp*>(take(n)), n};
+    image.asm_text = {take(h.asm_text_size), h.asm_text_size};
+    image.analysis = std::move(mapping);
+
+    if (checkCachedImage(image))
+        return true;
+    image.opcodes = {};
+    image.pc_check = {};
+    image.fused = {};
+    image.block_end = {};
+    image.loops = {};
+    image.loop_of = {};
+    image.asm_text = {};
+    image.asm_offset = {};
+    image.analysis.reset();
+    return false;
+}
+
+/*
+ * The values read from a cache, in the ranges the simulator indexes with
+ * them. The checksum stands for the rest.
+ */
+bool Simulator::checkCachedImage(const ProgramImage& image)
+{
+    const auto& opcodes = image.opcodes;
+    auto n = image.codes.size();
+    auto loop_num = static_cast<int64_t>(image.loops.size());
+
+    if (not image.asm_text.empty() && image.asm_text.back() != '\0')
+        return false;
+
+    for (size_t i = 0; i < n; i++) {
+        if (static_cast<uint32_t>(opcodes[i]) >= OPCODE_LIMIT)
+            return false;
+        if (image.asm_offset[i] >= image.asm_text.size())
+            return false;
+        if (image.loop_of[i] < -1 || image.loop_of[i] >= loop_num)
+            return false;
+
+        // Fused pairs are run without looking at the opcodes
+        auto fused = image.fused[i];
+        if (fused == FusedOp::NONE)
+            continue;
+        if (i + 1 >= n)
+            return false;
+        switch (fused) {
+#define FUSED_PAIR_CHECK(a, b, first, second)                       \
+    case FusedOp::a##_##b:                                          \
+        if (opcodes[i] != OpCode::a || opcodes[i + 1] != OpCode::b) \
+            return false;                                           \
+        break;
+
+            FELIS_SIM_FOR_EACH_FUSED_PAIR(FUSED_PAIR_CHECK)
+
+#undef FUSED_PAIR_CHECK
+        default:  // the ROI markers, or not a FusedOp
+            return false;
+        }
+    }
+
+    // A parent comes before its children, as in findLoops()
+    for (int64_t l = 0; l < loop_num; l++) {
+        const auto& loop = image.loops[l];
+        if (loop.header > loop.latch || loop.latch >= n)
+            return false;
+        if (loop.parent < -1 || loop.parent >= l)
+            return false;
+    }
+    return true;
+}
+
+// Written to a temporary file and renamed, for other simulators reading it
+void Simulator::saveCachedImage(
+    const ProgramImage& image, const std::string& dir)
+{
+    uint64_t key;
+    if (not cacheKey(image.codes, key)) {
+        std::cerr << "# Warning: Image cache isn't used, as the simulator"
+                     " executable couldn't be read: "
+                  << strerror(errno) << std::endl;
+        return;
+    }
+
+    auto n = image.codes.size();
+    CacheHeader h = {{'F', 'S', 'I', 'C'}, CACHE_VERSION, key,
+        static_cast<uint32_t>(n),
+        static_cast<uint32_t>(image.loops.size()),
+        static_cast<uint32_t>(image.asm_text.size()), 0, 0};
+
+    std::vector<char> buf(cacheSize(h));
+    auto pos = buf.data();
+    auto put = [&pos](const void* src, size_t bytes) {
+        if (bytes > 0)
+            std::memcpy(pos, src, bytes);
+        pos += bytes;
+    };
+    put(&h, sizeof h);
+    put(image.opcodes.data(), 4 * n);
+    put(image.asm_offset.data(), 4 * n);
+    put(image.loop_of.data(), 4 * n);
+    put(image.loops.data(), sizeof(ProgramImage::Loop) * image.loops.size());
+    put(image.pc_check.data(), n);
+    put(image.block_end.data(), n);
+    put(image.fused.data(), n);
+    put(image.asm_text.data(), image.asm_text.size());
+    h.checksum = hashBytes(buf.data() + sizeof h, buf.size() - sizeof h);
+    std::memcpy(buf.data(), &h, sizeof h);
+
+    mkdir(dir.c_str(), 0755);
+    auto path = cachePath(dir, h.key);
+    auto tmp = path + '.' + std::to_string(getpid());
+    auto fp = fopen(tmp.c_str(), "wb");
+    bool ok = fp != nullptr;
+    int err = errno;
+    if (ok) {
+        ok = fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+        ok = fclose(fp) == 0 && ok;
+        ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+        err = errno;
+        if (not ok)
+            unlink(tmp.c_str());
+    }
+    // The run itself goes on without the cache
+    if (not ok)
+        std::cerr << "# Warning: Image cache " << path
+                  << " couldn't be written: " << strerror(err) << std::endl;
+}
@@ -1,14 +1,17 @@
 #include "simulator.hpp"
 #include <cmath>
 
+template <class P>
 Simulator::PreState Simulator::abs_s(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreFRegState(op.rt);
+    auto pre_state = makePreFRegState<P>(op.rt);
 
-    m_freg.at(op.rt) = std::abs(m_freg.at(op.rs));
+    m_freg[op.rt] = std::abs(m_freg[op.rs]);
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(abs_s)
@@ -1,13 +1,16 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::andi(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreGPRegState(op.rt);
+    auto pre_state = makePreGPRegState<P>(op.rt);
 
-    m_reg.at(op.rt) = m_reg.at(op.rs) & op.immediate;
+    m_reg[op.rt] = m_reg[op.rs] & op.immediate;
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(andi)
@@ -1,13 +1,19 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::asrt_s(Instruction inst)
 {
     auto rs = bitset(inst, 6, 11);
-    auto reg = ftou(m_freg.at(rs));
+    auto reg = ftou(m_freg[rs]);
     auto expected = m_codes.at(m_pc / 4 + 1);
 
     if (reg != expected) {
+        if (not g_ncurses)
+            FAIL("# Error: Assertion failed at PC " << m_pc << ": $f" << rs
+                 << " expected 0x" << std::hex << expected
+                 << ", actually 0x" << reg);
+
         printConsole();
 
         addstr("Assertion failed.\n");
@@ -21,8 +27,10 @@ Simulator::PreState Simulator::asrt_s(Instruction inst)
         std::exit(1);
     }
 
-    auto pre_state = makePrePCState(m_pc);
+    auto pre_state = makePrePCState<P>(m_pc);
     m_pc += 8;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(asrt_s)
@@ -1,16 +1,19 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::bgez(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePrePCState(m_pc);
+    auto pre_state = makePrePCState<P>(m_pc);
 
-    if (m_reg.at(op.rs) >= 0)
+    if (m_reg[op.rs] >= 0)
         m_pc += signExt(op.immediate, 16) * 4;
     else
         m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(bgez)
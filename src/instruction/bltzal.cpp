@@ -1,21 +1,24 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::bltzal(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePrePCState(m_pc);
+    auto pre_state = makePrePCState<P>(m_pc);
 
-    if (m_reg.at(op.rs) < 0) {
+    if (m_reg[op.rs] < 0) {
         pre_state.gpreg.changed = true;
         pre_state.gpreg.idx = 31;
-        pre_state.gpreg.preval = m_reg.at(31);
+        pre_state.gpreg.preval = m_reg[31];
 
-        m_reg.at(31) = static_cast<int32_t>(m_pc + 4);
+        m_reg[31] = static_cast<int32_t>(m_pc + 4);
         m_pc += signExt(op.immediate, 16) * 4;
     } else
         m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(bltzal)
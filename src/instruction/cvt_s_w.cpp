@@ -1,14 +1,21 @@
 #include "simulator.hpp"
 #include "util.hpp"
+#include "fpu.hpp"
 
+template <class P>
 Simulator::PreState Simulator::cvt_s_w(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreFRegState(op.rt);
+    auto pre_state = makePreFRegState<P>(op.rt);
 
-    m_freg.at(op.rt) = static_cast<float>(ftob(m_freg.at(op.rs)));
+    if (P::hw_fpu)
+        m_freg[op.rt] = utof(fpu::itof(ftob(m_freg[op.rs])));
+    else
+        m_freg[op.rt] = static_cast<float>(ftob(m_freg[op.rs]));
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(cvt_s_w)
@@ -1,16 +1,23 @@
 #include <cmath>
 #include "simulator.hpp"
 #include "util.hpp"
+#include "fpu.hpp"
 
+template <class P>
 Simulator::PreState Simulator::cvt_w_s(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreFRegState(op.rt);
+    auto pre_state = makePreFRegState<P>(op.rt);
 
-    m_freg.at(op.rt)
-        = btof(static_cast<int32_t>(std::nearbyint(m_freg.at(op.rs))));
+    if (P::hw_fpu)
+        m_freg[op.rt] = btof(fpu::ftoi(ftou(m_freg[op.rs])));
+    else
+        m_freg[op.rt]
+            = btof(static_cast<int32_t>(std::nearbyint(m_freg[op.rs])));
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(cvt_w_s)
@@ -1,13 +1,16 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::div(Instruction inst)
 {
     auto op = decodeR(inst);
 
-    auto pre_state = makePreGPRegState(op.rd);
+    auto pre_state = makePreGPRegState<P>(op.rd);
 
-    m_reg.at(op.rd) = m_reg.at(op.rs) / m_reg.at(op.rt);
+    m_reg[op.rd] = m_reg[op.rs] / m_reg[op.rt];
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(div)
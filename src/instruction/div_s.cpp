@@ -1,13 +1,22 @@
 #include "simulator.hpp"
+#include "util.hpp"
+#include "fpu.hpp"
 
+template <class P>
 Simulator::PreState Simulator::div_s(Instruction inst)
 {
     auto op = decodeR(inst);
 
-    auto pre_state = makePreFRegState(op.rd);
+    auto pre_state = makePreFRegState<P>(op.rd);
 
-    m_freg.at(op.rd) = m_freg.at(op.rs) / m_freg.at(op.rt);
+    if (P::hw_fpu)
+        m_freg[op.rd] = utof(
+            fpu::fdiv(ftou(m_freg[op.rs]), ftou(m_freg[op.rt])));
+    else
+        m_freg[op.rd] = m_freg[op.rs] / m_freg[op.rt];
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(div_s)
@@ -1,15 +1,18 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::divi(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreGPRegState(op.rt);
+    auto pre_state = makePreGPRegState<P>(op.rt);
 
-    m_reg.at(op.rt) = m_reg.at(op.rs)
-                      / static_cast<int32_t>(signExt(op.immediate, 16));
+    m_reg[op.rt] = m_reg[op.rs]
+                   / static_cast<int32_t>(signExt(op.immediate, 16));
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(divi)
@@ -1,13 +1,14 @@
-#include <ncurses.h>
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::halt(Instruction /* inst */)
 {
     m_halt = true;
     m_running = false;
 
     m_outfile << std::flush;
-    dumpLog();
 
-    return makePrePCState(m_pc);
+    return makePrePCState<P>(m_pc);
 }
+
+FELIS_SIM_INSTANTIATE_INST(halt)
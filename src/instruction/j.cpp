@@ -1,12 +1,15 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::j(Instruction inst)
 {
     auto op = decodeJ(inst);
 
-    auto pre_state = makePrePCState(m_pc);
+    auto pre_state = makePrePCState<P>(m_pc);
 
     m_pc = (m_pc & 0xf0000003) | (op.addr << 2);
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(j)
@@ -1,13 +1,16 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::jal(Instruction inst)
 {
     auto op = decodeJ(inst);
 
-    auto pre_state = makePreGPRegState(31);
+    auto pre_state = makePreGPRegState<P>(31);
 
-    m_reg.at(31) = static_cast<int32_t>(m_pc + 4);
+    m_reg[31] = static_cast<int32_t>(m_pc + 4);
     m_pc = (m_pc & 0xf0000003) | (op.addr << 2);
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(jal)
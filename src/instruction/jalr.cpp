@@ -1,13 +1,16 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::jalr(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreGPRegState(op.rt);
+    auto pre_state = makePreGPRegState<P>(op.rt);
 
-    m_reg.at(op.rt) = static_cast<int32_t>(m_pc + 4);
-    m_pc = m_reg.at(op.rs);
+    m_reg[op.rt] = static_cast<int32_t>(m_pc + 4);
+    m_pc = m_reg[op.rs];
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(jalr)
@@ -1,12 +1,15 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::jr(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePrePCState(m_pc);
+    auto pre_state = makePrePCState<P>(m_pc);
 
-    m_pc = m_reg.at(op.rs);
+    m_pc = m_reg[op.rs];
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(jr)
@@ -1,13 +1,16 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::lui(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreGPRegState(op.rt);
+    auto pre_state = makePreGPRegState<P>(op.rt);
 
     m_pc += 4;
-    m_reg.at(op.rt) = op.immediate << 16;
+    m_reg[op.rt] = op.immediate << 16;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(lui)
@@ -1,18 +1,22 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::lwc1(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreFRegState(op.rt);
+    auto pre_state = makePreFRegState<P>(op.rt);
 
-    auto addr = (m_reg.at(op.rs)
-                    + static_cast<int32_t>(signExt(op.immediate, 16))) / 4;
-    checkMemoryIndex(addr);
+    uint32_t addr = (m_reg[op.rs]
+                        + static_cast<int32_t>(signExt(op.immediate, 16))) / 4;
+    checkMemoryIndex<P>(addr, false);
+    watchMemory(addr, false);
 
-    m_freg.at(op.rt) = btof(m_memory[addr]);
+    m_freg[op.rt] = btof(m_memory[addr]);
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(lwc1)
@@ -1,17 +1,21 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::lwo(Instruction inst)
 {
     auto op = decodeR(inst);
 
-    auto pre_state = makePreGPRegState(op.rd);
+    auto pre_state = makePreGPRegState<P>(op.rd);
 
-    auto addr = (m_reg.at(op.rs) + m_reg.at(op.rt)) / 4;
-    checkMemoryIndex(addr);
+    uint32_t addr = (m_reg[op.rs] + m_reg[op.rt]) / 4;
+    checkMemoryIndex<P>(addr, false);
+    watchMemory(addr, false);
 
-    m_reg.at(op.rd) = m_memory[addr];
+    m_reg[op.rd] = m_memory[addr];
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(lwo)
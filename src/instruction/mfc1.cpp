@@ -1,14 +1,17 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::mfc1(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreGPRegState(op.rt);
+    auto pre_state = makePreGPRegState<P>(op.rt);
 
-    m_reg.at(op.rt) = ftob(m_freg.at(op.rs));
+    m_reg[op.rt] = ftob(m_freg[op.rs]);
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(mfc1)
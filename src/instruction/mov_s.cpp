@@ -1,13 +1,16 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::mov_s(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreFRegState(op.rt);
+    auto pre_state = makePreFRegState<P>(op.rt);
 
-    m_freg.at(op.rt) = m_freg.at(op.rs);
+    m_freg[op.rt] = m_freg[op.rs];
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(mov_s)
@@ -1,14 +1,17 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::mtc1(Instruction inst)
 {
     auto op = decodeI(inst);
 
-    auto pre_state = makePreFRegState(op.rt);
+    auto pre_state = makePreFRegState<P>(op.rt);
 
-    m_freg.at(op.rt) = btof(m_reg.at(op.rs));
+    m_freg[op.rt] = btof(m_reg[op.rs]);
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(mtc1)
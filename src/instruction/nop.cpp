@@ -1,9 +1,12 @@
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::nop(Instruction /* inst */)
 {
-    auto pre_state = makePrePCState(m_pc);
+    auto pre_state = makePrePCState<P>(m_pc);
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(nop)
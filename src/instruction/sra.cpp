@@ -1,14 +1,17 @@
 #include "util.hpp"
 #include "simulator.hpp"
 
+template <class P>
 Simulator::PreState Simulator::sra(Instruction inst)
 {
     auto op = decodeR(inst);
 
-    auto pre_state = makePreGPRegState(op.rd);
+    auto pre_state = makePreGPRegState<P>(op.rd);
 
-    m_reg.at(op.rd) = signExt(m_reg.at(op.rs) >> op.shamt, 32 - op.shamt);
+    m_reg[op.rd] = signExt(m_reg[op.rs] >> op.shamt, 32 - op.shamt);
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(sra)
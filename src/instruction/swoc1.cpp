@@ -1,17 +1,22 @@
 #include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::swoc1(Instruction inst)
 {
     auto op = decodeR(inst);
 
-    auto addr = (m_reg.at(op.rt) + m_reg.at(op.rd)) / 4;
-    checkMemoryIndex(addr);
+    uint32_t addr = (m_reg[op.rt] + m_reg[op.rd]) / 4;
+    checkMemoryIndex<P>(addr, true);
+    watchMemory(addr, true);
 
-    auto pre_state = makeMemPreState(addr);
+    auto pre_state = makeMemPreState<P>(addr);
 
-    m_memory[addr] = ftob(m_freg.at(op.rs));
+    m_memory[addr] = ftob(m_freg[op.rs]);
+    recordWriter(addr);
     m_pc += 4;
 
     return pre_state;
 }
+
+FELIS_SIM_INSTANTIATE_INST(swoc1)
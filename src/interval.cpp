@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstdio>
+#include "util.hpp"
+#include "simulator.hpp"
+
+constexpr uint32_t Simulator::INTERVAL_PAGE_WORDS;
+
+namespace
+{
+
+enum Kind { ALU, FPU, LOAD, STORE, BRANCH, JUMP, IN, OUT, KIND_NUM };
+const char* const KIND_NAMES[KIND_NUM]
+    = {"alu", "fpu", "load", "store", "branch", "jump", "in", "out"};
+
+Kind kindOf(OpCode op)
+{
+    switch (op) {
+    case OpCode::LW:
+    case OpCode::LWO:
+    case OpCode::LWC1:
+    case OpCode::LWOC1:
+        return LOAD;
+    case OpCode::SW:
+    case OpCode::SWO:
+    case OpCode::SWC1:
+    case OpCode::SWOC1:
+        return STORE;
+    case OpCode::BEQ:
+    case OpCode::BGEZ:
+    case OpCode::BGTZ:
+    case OpCode::BLEZ:
+    case OpCode::BLTZ:
+    case OpCode::BGEZAL:
+    case OpCode::BLTZAL:
+        return BRANCH;
+    case OpCode::J:
+    case OpCode::JAL:
+    case OpCode::JR:
+    case OpCode::JALR:
+        return JUMP;
+    case OpCode::IN:
+        return IN;
+    case OpCode::OUT:
+        return OUT;
+    case OpCode::ASRT_S:
+    case OpCode::MTC1:
+    case OpCode::MFC1:
+    case OpCode::ABS_S:
+    case OpCode::NEG_S:
+    case OpCode::ADD_S:
+    case OpCode::SUB_S:
+    case OpCode::MUL_S:
+    case OpCode::DIV_S:
+    case OpCode::CVT_S_W:
+    case OpCode::CVT_W_S:
+    case OpCode::MOV_S:
+    case OpCode::SQRT_S:
+        return FPU;
+    default:
+        return ALU;
+    }
+}
+
+}  // namespace
+
+void Simulator::beginIntervals()
+{
+    m_interval_file.close();
+    m_interval_file.open("interval.csv");
+    if (m_interval_file.fail())
+        FAIL("# Error: File interval.csv couldn't be opened for writing");
+
+    m_interval_file << "start,insts";
+    for (auto name : KIND_NAMES)
+        m_interval_file << ',' << name;
+    m_interval_file << ",pages,taken_ratio\n";
+
+    m_interval = Interval{};
+    m_interval_mix.assign(KIND_NUM, 0);
+    m_run_begin = m_image->entry / 4;
+    m_page_stamp.assign(
+        (m_memory_num + INTERVAL_PAGE_WORDS - 1) / INTERVAL_PAGE_WORDS, 0);
+
+    const auto& opcodes = m_image->opcodes;
+    m_kinds_before.assign(KIND_NUM * (m_codes.size() + 1), 0);
+    for (size_t i = 0; i < m_codes.size(); i++) {
+        auto row = &m_kinds_before[KIND_NUM * i];
+        std::copy(row, row + KIND_NUM, row + KIND_NUM);
+        row[KIND_NUM + kindOf(opcodes[i])]++;
+    }
+
+    if (not m_collect_bbv)
+        return;
+
+    // The frequency vectors of SimPoint, with the interval length ahead
+    m_bbv_file.close();
+    m_bbv_file.open("bbv.txt");
+    if (m_bbv_file.fail())
+        FAIL("# Error: File bbv.txt couldn't be opened for writing");
+    m_bbv_file << "# interval = " << m_interval_len << '\n';
+
+    // Blocks are split only at block ends, so that a branch target in the
+    // middle of one doesn't start another
+    uint32_t block = 1;
+    m_block_of.resize(m_codes.size());
+    for (size_t i = 0; i < m_codes.size(); i++) {
+        m_block_of[i] = block;
+        if (m_image->block_end[i])
+            block++;
+    }
+    m_bbv.assign(block + 1, 0);
+}
+
+// The codes in [begin, end), run straight in a block
+void Simulator::addIntervalRun(size_t begin, size_t end)
+{
+    if (begin >= end)
+        return;
+    auto before = &m_kinds_before[KIND_NUM * begin];
+    auto after = &m_kinds_before[KIND_NUM * end];
+    for (int k = 0; k < KIND_NUM; k++)
+        m_interval_mix[k] += after[k] - before[k];
+
+    if (m_collect_bbv) {
+        auto& n = m_bbv[m_block_of[begin]];
+        if (n == 0)
+            m_bbv_touched.emplace_back(m_block_of[begin]);
+        n += static_cast<int64_t>(end - begin);
+    }
+}
+
+// Called before the code at 'idx' is counted. Control leaves the straight
+// line only at block ends, so the codes since the last one are a run up to
+// 'idx'.
+void Simulator::profileInterval(size_t idx)
+{
+    auto op = m_image->opcodes[idx];
+    auto length = m_cnt.dynamic_inst - m_interval.start;
+    auto end = m_interval_len * static_cast<int64_t>(m_interval.number);
+    if (m_cnt.dynamic_inst >= end || (op == OpCode::HALT && length > 0)) {
+        addIntervalRun(m_run_begin, idx);
+        flushInterval();
+        m_run_begin = idx;
+    }
+    if (op == OpCode::HALT) {
+        m_interval_file.flush();
+        m_bbv_file.flush();
+    } else {
+        addIntervalRun(m_run_begin, idx + 1);
+    }
+    m_run_begin = m_pc / 4;
+
+    if (kindOf(op) == BRANCH && m_pc / 4 != idx + 1)
+        m_interval.taken++;
+}
+
+void Simulator::flushInterval()
+{
+    const auto& mix = m_interval_mix;
+
+    char ratio[32];
+    snprintf(ratio, sizeof ratio, "%.4f",
+        mix[BRANCH] > 0 ? static_cast<double>(m_interval.taken)
+                              / static_cast<double>(mix[BRANCH])
+                        : 0.0);
+
+    auto& ofs = m_interval_file;
+    ofs << m_interval.start << ',' << m_cnt.dynamic_inst - m_interval.start;
+    for (auto n : mix)
+        ofs << ',' << n;
+    ofs << ',' << m_interval.pages << ',' << ratio << '\n';
+
+    if (m_collect_bbv) {
+        std::sort(m_bbv_touched.begin(), m_bbv_touched.end());
+        m_bbv_file << 'T';
+        for (auto b : m_bbv_touched) {
+            m_bbv_file << ':' << b << ':' << m_bbv[b] << ' ';
+            m_bbv[b] = 0;
+        }
+        m_bbv_file << '\n';
+        m_bbv_touched.clear();
+    }
+    std::fill(m_interval_mix.begin(), m_interval_mix.end(), 0);
+
+    m_interval.start = m_cnt.dynamic_inst;
+    m_interval.number++;
+    m_interval.pages = 0;
+    m_interval.taken = 0;
+}
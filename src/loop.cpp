@@ -0,0 +1,218 @@
+#include <algorithm>
+#include "util.hpp"
+#include "simulator.hpp"
+
+void Simulator::findLoops(
+    const std::vector<Instruction>& codes, ProgramImage::Analysis& analysis)
+{
+    const auto& opcodes = analysis.opcodes;
+    auto code_num = static_cast<int64_t>(codes.size());
+
+    analysis.block_end.assign(codes.size(), 0);
+
+    // Back edges, as (header, latch)
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (int64_t idx = 0; idx < code_num; idx++) {
+        auto inst = codes[idx];
+        int64_t target = -1;
+
+        switch (opcodes[idx]) {
+        case OpCode::BEQ:
+        case OpCode::BGEZ:
+        case OpCode::BGTZ:
+        case OpCode::BLEZ:
+        case OpCode::BLTZ:
+            target = idx + static_cast<int32_t>(
+                               signExt(decodeI(inst).immediate, 16));
+            break;
+        case OpCode::J: {
+            auto pc = static_cast<uint32_t>(idx * 4);
+            target = ((pc & 0xf0000003) | (decodeJ(inst).addr << 2)) / 4;
+            break;
+        }
+        case OpCode::BGEZAL:
+        case OpCode::BLTZAL:
+        case OpCode::JAL:
+        case OpCode::JR:
+        case OpCode::JALR:
+        case OpCode::HALT:
+        case OpCode::ASRT:    // skips the next code
+        case OpCode::ASRT_S:
+            break;
+        default:
+            continue;
+        }
+
+        analysis.block_end[idx] = 1;
+        if (0 <= target && target <= idx)
+            edges.emplace_back(target, idx);
+    }
+
+    // One loop per header, up to the last latch
+    std::sort(edges.begin(), edges.end());
+    auto& loops = analysis.loops;
+    loops.clear();
+    for (const auto& e : edges) {
+        if (not loops.empty() && loops.back().header == e.first)
+            loops.back().latch = std::max(loops.back().latch, e.second);
+        else
+            loops.push_back(ProgramImage::Loop{e.first, e.second, -1});
+    }
+
+    // Nest by the ranges. A loop overlapping another without being inside
+    // it is put next to it.
+    analysis.loop_of.assign(codes.size(), -1);
+    std::vector<int32_t> enclosing;
+    for (size_t l = 0; l < loops.size(); l++) {
+        while (not enclosing.empty()
+               && loops[enclosing.back()].latch < loops[l].latch)
+            enclosing.pop_back();
+        loops[l].parent = enclosing.empty() ? -1 : enclosing.back();
+        enclosing.push_back(static_cast<int32_t>(l));
+
+        for (auto idx = loops[l].header; idx <= loops[l].latch; idx++)
+            analysis.loop_of[idx] = static_cast<int32_t>(l);
+    }
+}
+
+// Loops containing each code, as overlapping loops aren't nested
+void Simulator::indexLoops()
+{
+    const auto& loops = m_image->loops;
+    m_loops_at_begin.assign(m_codes.size() + 1, 0);
+    for (const auto& loop : loops) {
+        for (auto idx = loop.header; idx <= loop.latch; idx++)
+            m_loops_at_begin[idx + 1]++;
+    }
+    for (size_t idx = 0; idx < m_codes.size(); idx++)
+        m_loops_at_begin[idx + 1] += m_loops_at_begin[idx];
+
+    m_loops_at.resize(m_loops_at_begin.back());
+    auto pos = m_loops_at_begin;
+    for (size_t l = 0; l < loops.size(); l++) {
+        for (auto idx = loops[l].header; idx <= loops[l].latch; idx++)
+            m_loops_at[pos[idx]++] = static_cast<uint32_t>(l);
+    }
+}
+
+/*
+ * A taken back edge is an iteration of the loop whose header is its
+ * target, and leaving a loop other than by a call closes its entry.
+ * Every loop containing the code is checked, since a loop overlapping
+ * another is not its child in ProgramImage::loop_of.
+ * Calls are expected to return into the loop, so that they close nothing.
+ */
+void Simulator::profileBlockEnd(size_t idx)
+{
+    if (m_interval_len > 0)
+        profileInterval(idx);
+
+    if (m_cnt.loops.empty())
+        return;
+
+    const auto& loops = m_image->loops;
+    auto next = m_pc / 4;
+    bool call, halt = false;
+    switch (m_image->opcodes[idx]) {
+    case OpCode::JAL:
+    case OpCode::JALR:
+        call = true;
+        break;
+    case OpCode::BGEZAL:
+    case OpCode::BLTZAL:
+        call = next != idx + 1;
+        break;
+    case OpCode::HALT:
+        call = false;
+        halt = true;
+        break;
+    default:
+        call = false;
+        break;
+    }
+    if (call)
+        return;
+
+    for (auto i = m_loops_at_begin[idx]; i < m_loops_at_begin[idx + 1]; i++) {
+        auto l = m_loops_at[i];
+        const auto& loop = loops[l];
+        auto& cnt = m_cnt.loops[l];
+        if (not halt && loop.header <= next && next <= loop.latch) {
+            if (next == loop.header && next <= idx) {
+                cnt.iterations++;
+                cnt.trip++;
+            }
+        } else {
+            closeLoop(cnt);
+        }
+    }
+
+    // Loops of the callers may also be running
+    if (halt) {
+        for (auto& cnt : m_cnt.loops) {
+            if (cnt.trip > 0)
+                closeLoop(cnt);
+        }
+    }
+}
+
+void Simulator::closeLoop(Counters::LoopCounter& cnt)
+{
+    auto trips = static_cast<uint64_t>(cnt.trip) + 1;
+    int bucket = 0;
+    while (trips >>= 1)
+        bucket++;
+
+    // The first trip of an entry takes no back edge
+    cnt.entries++;
+    cnt.iterations++;
+    cnt.trip_hist[bucket]++;
+    cnt.trip = 0;
+}
+
+void Simulator::dumpLoops(const Counters& cnt, const ProgramImage& image)
+{
+    using namespace std;
+
+    const auto& loops = image.loops;
+    vector<int64_t> insts(loops.size());
+    for (size_t l = 0; l < loops.size(); l++) {
+        for (auto idx = loops[l].header; idx <= loops[l].latch; idx++)
+            insts[l] += cnt.pc_called.at(idx);
+    }
+
+    vector<size_t> order(loops.size());
+    for (size_t l = 0; l < order.size(); l++)
+        order[l] = l;
+    stable_sort(order.begin(), order.end(),
+        [&insts](size_t a, size_t b) { return insts[a] > insts[b]; });
+
+    ofstream ofs{"loop.log"};
+    ofs << "# dynamic inst cnt = " << cnt.dynamic_inst << endl;
+    ofs << "# header PC, latch PC : entries, iterations, insts (ratio),"
+           " trip count histogram"
+        << endl;
+    for (auto l : order) {
+        const auto& c = cnt.loops.at(l);
+        char ratio[32];
+        snprintf(ratio, sizeof ratio, "%.2f%%",
+            cnt.dynamic_inst > 0
+                ? 100.0 * static_cast<double>(insts[l])
+                      / static_cast<double>(cnt.dynamic_inst)
+                : 0.0);
+
+        ofs << 4 * loops[l].header << ' ' << 4 * loops[l].latch << " : "
+            << c.entries << ' ' << c.iterations << ' ' << insts[l] << " ("
+            << ratio << ")";
+        for (int b = 0; b < Counters::LoopCounter::TRIP_HIST_NUM; b++) {
+            if (c.trip_hist[b] == 0)
+                continue;
+            auto lo = uint64_t{1} << b, hi = (lo << 1) - 1;
+            ofs << ' ' << lo;
+            if (hi > lo)
+                ofs << '-' << hi;
+            ofs << ':' << c.trip_hist[b];
+        }
+        ofs << endl;
+    }
+}
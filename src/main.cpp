@@ -1,4 +1,5 @@
 #include <iostream>
+#include <fstream>
 #include <getopt.h>
 #include "util.hpp"
 #include "simulator.hpp"
@@ -19,45 +20,122 @@ int main(int argc, char** argv)
         }
 
         int result;
-        bool interactive = true, output_memory = false,
-             prev_disable = false, disasm = false, quit_run = false;
-        int32_t memory_num = 1000000;
+        bool disasm = false, headless = false;
+        int thread_num = 0;
         std::string binfile;
-        std::string infile;
-        std::string outfile = "out.log";
+        std::string sweep_list;
+        std::string host_profile;
+        std::string cache_dir;
+        Simulator::Config config;
 
-        while ((result = getopt(argc, argv, "rmndqs:f:i:o:")) != -1) {
+        while ((result = getopt(argc, argv, "rmndqbuxLVBs:f:i:o:w:j:p:W:R:P:I:S:O:M:H:C:")) != -1) {
             switch (result) {
             case 'r':
-                interactive = false;
+                config.interactive = false;
                 break;
             case 'm':
-                output_memory = true;
+                config.output_memory = true;
                 break;
             case 'n':
-                prev_disable = true;
+                config.prev_disable = true;
                 break;
             case 'd':
                 disasm = true;
                 break;
             case 'q':
-                quit_run = true;
+                config.quit_run = true;
                 break;
-            case 's':
-                memory_num = std::atoi(optarg);
+            case 'b':
+                headless = true;
+                config.interactive = false;
+                break;
+            case 'u':
+                config.checked = false;
+                break;
+            case 'x':
+                config.fuse = false;
+                break;
+            case 'L':
+                config.loop_profile = true;
+                break;
+            case 'V':
+                config.bbv = true;
+                break;
+            case 'B':
+                config.binary_stats = true;
+                break;
+            case 's': {
+                int32_t memory_num = std::atoi(optarg);
                 if (memory_num < 0) {
                     std::cerr << "# Error: Invalid memory size" << std::endl;
                     return 1;
                 }
+                config.memory_num = static_cast<size_t>(memory_num);
                 break;
+            }
             case 'f':
                 binfile = optarg;
                 break;
             case 'i':
-                infile = optarg;
+                config.infile = optarg;
                 break;
             case 'o':
-                outfile = optarg;
+                config.outfile = optarg;
+                break;
+            case 'w':
+                sweep_list = optarg;
+                break;
+            case 'j':
+                thread_num = std::atoi(optarg);
+                break;
+            case 'p':
+                config.sample_hz = std::atoi(optarg);
+                if (config.sample_hz <= 0) {
+                    std::cerr << "# Error: Invalid sampling rate" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'W':
+                config.writer_depth = std::atoi(optarg);
+                if (config.writer_depth <= 0) {
+                    std::cerr << "# Error: Invalid writer history depth"
+                              << std::endl;
+                    return 1;
+                }
+                break;
+            case 'R':
+                config.reuse_line = std::atoi(optarg);
+                if (config.reuse_line <= 0) {
+                    std::cerr << "# Error: Invalid cache line size"
+                              << std::endl;
+                    return 1;
+                }
+                break;
+            case 'P':
+                config.prefetchers = optarg;
+                break;
+            case 'I':
+                config.interval = std::atoll(optarg);
+                if (config.interval <= 0) {
+                    std::cerr << "# Error: Invalid interval length"
+                              << std::endl;
+                    return 1;
+                }
+                break;
+            case 'S':
+                config.simpoints = optarg;
+                break;
+            case 'O':
+                config.roi = optarg;
+                break;
+            case 'M':
+                config.metrics = optarg;
+                break;
+            case 'H':
+                host_profile = optarg;
+                break;
+            case 'C':
+                cache_dir = optarg;
                 break;
             case '?':
             default:
@@ -68,7 +146,72 @@ int main(int argc, char** argv)
         if (binfile.empty())
             FAIL("# Error: No binfile given");
 
-        if (not disasm) {
+        if (config.interval > 0 && config.sample_hz > 0)
+            FAIL("# Error: Interval statistics can't be used with PC sampling");
+        if (config.bbv && config.interval <= 0)
+            FAIL("# Error: Basic block vectors need an interval length (-I)");
+        if (not config.simpoints.empty()) {
+            if (not headless || not sweep_list.empty())
+                FAIL("# Error: Simulation points can be run only with -b");
+            // The prefetcher statistics aren't scaled by the weights, and
+            // loops running across the fast-forwarded codes have no trip
+            // counts
+            if (config.interval > 0 || config.sample_hz > 0
+                || not config.prefetchers.empty() || config.loop_profile)
+                FAIL("# Error: Simulation points can't be run with -I, -p, "
+                     "-P or -L");
+        }
+        if (not config.roi.empty()) {
+            if (not headless && sweep_list.empty())
+                FAIL("# Error: ROI can be used only with -b or -w");
+            if (config.interval > 0 || config.sample_hz > 0
+                || not config.simpoints.empty())
+                FAIL("# Error: ROI can't be used with -I, -p or -S");
+        }
+
+        std::unique_ptr<HostProfiler> host;
+        if (not host_profile.empty()) {
+            if (host_profile != "phase" && host_profile != "opcode")
+                FAIL("# Error: Invalid host profile: " << host_profile);
+            if (not sweep_list.empty())
+                FAIL("# Error: Host counters can't be used with sweep");
+            bool handlers = host_profile == "opcode";
+            if (handlers
+                && (not headless || not config.simpoints.empty()
+                       || not config.roi.empty()))
+                FAIL("# Error: Handlers can be profiled only with -b, "
+                     "without -S or -O");
+            host.reset(new HostProfiler{handlers});
+        }
+
+        auto image = Simulator::loadImage(binfile, cache_dir);
+
+        if (not sweep_list.empty()) {
+            if (config.sample_hz > 0)
+                FAIL("# Error: PC sampling can't be used with sweep");
+            if (not config.prefetchers.empty())
+                FAIL("# Error: Prefetchers can't be evaluated with sweep");
+            if (config.interval > 0)
+                FAIL("# Error: Interval statistics can't be used with sweep");
+            if (not config.metrics.empty())
+                FAIL("# Error: Live metrics can't be used with sweep");
+
+            std::ifstream ifs{sweep_list};
+            if (ifs.fail())
+                FAIL("# Error: File " << sweep_list << " couldn't be opened");
+
+            std::vector<std::string> infiles;
+            std::string line;
+            while (std::getline(ifs, line)) {
+                if (not line.empty())
+                    infiles.emplace_back(line);
+            }
+
+            return Simulator::sweep(image, config, infiles, thread_num) ? 0
+                                                                         : 1;
+        }
+
+        if (not disasm && not headless) {
             // ncurses setting
             initscr();
             nocbreak();
@@ -79,19 +222,29 @@ int main(int argc, char** argv)
             std::atexit(endwin_);
         }
 
-        Simulator sim{binfile, infile, outfile,
-            static_cast<size_t>(memory_num),
-            interactive, output_memory, prev_disable, quit_run};
-        if (disasm)
+        Simulator sim{image, config};
+        if (disasm) {
             sim.disasm();
-        else
+        } else if (headless) {
+            sim.runHeadless();
+            sim.dumpLog();
+        } else {
             sim.run();
+        }
+
+        if (host) {
+            endwin_();
+            g_ncurses = false;
+            host->print();
+        }
 
         return 0;
     } catch (const std::exception& e) {
-        FAIL(e.what());
+        endwin_();
+        std::cerr << e.what() << std::endl;
     } catch (...) {
-        FAIL("# Error: Unknown exception");
+        endwin_();
+        std::cerr << "# Error: Unknown exception" << std::endl;
     }
 
     return 1;
@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "util.hpp"
+#include "simulator.hpp"
+
+constexpr uint32_t MetricsBlock::MAGIC;
+constexpr uint32_t MetricsBlock::VERSION;
+
+namespace
+{
+
+// Segments of the live publishers, unlinked also at std::exit(), which
+// skips their destructors
+std::mutex g_segments_mutex;
+std::set<std::string> g_segments;
+
+void unlinkSegments()
+{
+    std::lock_guard<std::mutex> lock{g_segments_mutex};
+    for (const auto& name : g_segments)
+        shm_unlink(name.c_str());
+    g_segments.clear();
+}
+
+}  // namespace
+
+MetricsPublisher::MetricsPublisher(const std::string& name,
+    const char* const (&mnemonics)[MetricsBlock::OPCODE_NUM])
+    : m_name('/' + name)
+{
+    auto fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0)
+        FAIL("# Error: Shared memory " << m_name << " couldn't be created");
+    {
+        static std::once_flag registered;
+        std::call_once(registered, []() { std::atexit(unlinkSegments); });
+        std::lock_guard<std::mutex> lock{g_segments_mutex};
+        g_segments.insert(m_name);
+    }
+    if (ftruncate(fd, sizeof(MetricsBlock)) != 0)
+        FAIL("# Error: Shared memory " << m_name << " couldn't be resized");
+
+    auto p = mmap(nullptr, sizeof(MetricsBlock), PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        FAIL("# Error: Shared memory " << m_name << " couldn't be mapped");
+
+    // Zero-filled by ftruncate. The magic goes last, for readers polling it.
+    m_block = static_cast<MetricsBlock*>(p);
+    m_block->version = MetricsBlock::VERSION;
+    m_block->pid = getpid();
+    for (int op = 0; op < MetricsBlock::OPCODE_NUM; op++) {
+        if (mnemonics[op] != nullptr)
+            std::strncpy(m_block->mnemonic[op], mnemonics[op],
+                MetricsBlock::MNEMONIC_LEN - 1);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    m_block->magic = MetricsBlock::MAGIC;
+}
+
+MetricsPublisher::~MetricsPublisher()
+{
+    munmap(m_block, sizeof(MetricsBlock));
+    shm_unlink(m_name.c_str());
+
+    std::lock_guard<std::mutex> lock{g_segments_mutex};
+    g_segments.erase(m_name);
+}
+
+void Simulator::openMetrics(const std::string& name)
+{
+    const char* mnemonics[MetricsBlock::OPCODE_NUM] = {};
+    for (const auto& m : mnemonicTable()) {
+        auto op = static_cast<uint32_t>(m.first);
+        if (op < MetricsBlock::OPCODE_NUM)
+            mnemonics[op] = m.second.mnemonic;
+    }
+
+    // The values stay zero until the run publishes them from its start
+    m_metrics.reset(new MetricsPublisher{name, mnemonics});
+}
+
+void Simulator::publishMetrics()
+{
+    using namespace std::chrono;
+
+    MetricsBlock::Values v = {};
+    v.dynamic_inst = m_cnt.dynamic_inst;
+    v.elapsed_ns = duration_cast<nanoseconds>(
+        high_resolution_clock::now() - m_start_time)
+                       .count();
+    v.mips = v.elapsed_ns > 0 ? static_cast<double>(v.dynamic_inst) * 1e3
+                                    / static_cast<double>(v.elapsed_ns)
+                              : 0.0;
+    v.pc = m_pc;
+    v.halted = m_halt;
+    v.footprint = m_guarded_memory->residentSize();
+    for (const auto& p : m_cnt.inst) {
+        auto op = static_cast<uint32_t>(p.first);
+        if (op < MetricsBlock::OPCODE_NUM)
+            v.inst[op] = p.second;
+    }
+
+    m_metrics->block().write(v);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+ * Live metrics of a running simulator, in a POSIX shared memory segment.
+ * The simulator publishes them between chunks of execution, and readers
+ * (tools/metrics_reader.cpp) take consistent snapshots with a seqlock,
+ * so that the execution thread never waits for them.
+ */
+struct MetricsBlock {
+    static constexpr uint32_t MAGIC = 0x4d534c46;  // "FLSM"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr int OPCODE_NUM = 64;
+    static constexpr int MNEMONIC_LEN = 8;
+
+    struct Values {
+        int64_t dynamic_inst;
+        int64_t elapsed_ns;  // since the start of the run
+        double mips;         // average since the start of the run
+        uint32_t pc;
+        uint32_t halted;
+        uint64_t footprint;  // bytes of the touched pages of the memory
+        int64_t inst[OPCODE_NUM];  // by opcode, if counted
+    };
+
+    // Written once before the segment is published
+    uint32_t magic;
+    uint32_t version;
+    int64_t pid;
+    char mnemonic[OPCODE_NUM][MNEMONIC_LEN];  // empty for unused opcodes
+
+    std::atomic<uint64_t> seq;  // odd while the values are written
+    Values values;
+
+    void write(const Values& v)
+    {
+        auto s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&values, &v, sizeof v);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // A snapshot into 'v', or false if none was consistent in READ_RETRY_NUM
+    // tries, e.g. with the writer dead in the middle of write()
+    static constexpr int READ_RETRY_NUM = 1 << 20;
+    bool read(Values& v) const
+    {
+        for (int i = 0; i < READ_RETRY_NUM; i++) {
+            auto s = seq.load(std::memory_order_acquire);
+            if (s & 1)
+                continue;
+            std::memcpy(&v, &values, sizeof v);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s)
+                return true;
+        }
+        return false;
+    }
+};
+
+// The writer side, creating the segment '/<name>' and unlinking it at exit,
+// also at std::exit()
+class MetricsPublisher
+{
+public:
+    // 'mnemonics' are indexed by opcode, nullptr for unused ones
+    MetricsPublisher(const std::string& name,
+        const char* const (&mnemonics)[MetricsBlock::OPCODE_NUM]);
+    ~MetricsPublisher();
+
+    MetricsPublisher(const MetricsPublisher&) = delete;
+    MetricsPublisher& operator=(const MetricsPublisher&) = delete;
+
+    MetricsBlock& block() { return *m_block; }
+
+private:
+    const std::string m_name;
+    MetricsBlock* m_block;
+};
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <csignal>
+#include <sys/time.h>
+#include "util.hpp"
+#include "pc_sampler.hpp"
+
+PCSampler* PCSampler::s_active = nullptr;
+
+PCSampler::PCSampler(const uint32_t* pc, size_t code_num, int hz)
+    : m_pc(pc), m_hz(hz), m_samples(code_num + 1)  // last one is out of range
+{
+    if (s_active != nullptr)
+        FAIL("# Error: PC sampler is already running");
+    if (hz <= 0 || hz > 1000000)
+        FAIL("# Error: Invalid sampling rate: " << hz);
+
+    s_active = this;
+
+    struct sigaction sa;
+    sa.sa_handler = onSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGPROF, &sa, nullptr) != 0)
+        FAIL("# Error: Couldn't install SIGPROF handler");
+
+    // tv_usec must be less than a second
+    auto period = 1000000 / hz;
+    struct itimerval timer;
+    timer.it_interval.tv_sec = period / 1000000;
+    timer.it_interval.tv_usec = period % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+        FAIL("# Error: Couldn't start profiling timer");
+}
+
+PCSampler::~PCSampler()
+{
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    signal(SIGPROF, SIG_IGN);
+
+    s_active = nullptr;
+}
+
+void PCSampler::clear()
+{
+    for (auto& s : m_samples)
+        s = 0;
+    m_total = 0;
+}
+
+void PCSampler::onSignal(int)
+{
+    auto sampler = s_active;
+    if (sampler == nullptr)
+        return;
+
+    size_t pc_idx = *sampler->m_pc / 4;
+    auto& samples = sampler->m_samples;
+    if (pc_idx >= samples.size() - 1)
+        pc_idx = samples.size() - 1;
+
+    samples[pc_idx]++;
+    sampler->m_total = sampler->m_total + 1;
+}
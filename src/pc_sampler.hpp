@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Statistical PC profiler.
+ * Samples the program counter pointed by 'pc' at 'hz' on SIGPROF
+ * (ITIMER_PROF), so that the simulation loop itself does no counting.
+ * Only one sampler can be active in a process.
+ */
+class PCSampler
+{
+public:
+    PCSampler(const uint32_t* pc, size_t code_num, int hz);
+    ~PCSampler();
+
+    PCSampler(const PCSampler&) = delete;
+    PCSampler& operator=(const PCSampler&) = delete;
+
+    int hz() const { return m_hz; }
+    int64_t total() const { return m_total; }
+    const std::vector<int64_t>& samples() const { return m_samples; }  // PCごとのサンプル数
+
+    void clear();
+
+private:
+    const volatile uint32_t* const m_pc;
+    const int m_hz;
+
+    std::vector<int64_t> m_samples;
+    volatile int64_t m_total = 0;
+
+    static PCSampler* s_active;
+    static void onSignal(int);
+};
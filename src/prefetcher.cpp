@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include "util.hpp"
+#include "prefetcher.hpp"
+
+constexpr uint32_t Prefetcher::LINE_WORDS;
+constexpr uint32_t PrefetchEvaluator::CACHE_LINES;
+constexpr uint32_t PrefetchEvaluator::WAYS;
+constexpr int64_t PrefetchEvaluator::LATENCY;
+
+namespace
+{
+
+// The next 'degree' lines of every load
+class NextLinePrefetcher : public Prefetcher
+{
+public:
+    NextLinePrefetcher(std::string name, int degree)
+        : Prefetcher(std::move(name)), m_degree(degree)
+    {
+    }
+
+    void train(uint32_t, uint32_t idx, std::vector<uint32_t>& lines) override
+    {
+        auto line = idx / LINE_WORDS;
+        for (int d = 1; d <= m_degree; d++)
+            lines.push_back(line + static_cast<uint32_t>(d));
+    }
+
+private:
+    const int m_degree;
+};
+
+/*
+ * Reference prediction table indexed by the PC of the load.
+ * An entry predicts after seeing its stride twice in a row (a 2 bit
+ * confidence counter), and prefetches 'degree' strides ahead.
+ */
+class StridePrefetcher : public Prefetcher
+{
+public:
+    StridePrefetcher(std::string name, int degree)
+        : Prefetcher(std::move(name)), m_degree(degree)
+    {
+    }
+
+    void train(uint32_t pc, uint32_t idx, std::vector<uint32_t>& lines) override
+    {
+        auto& e = m_table[(pc / 4) % TABLE_SIZE];
+        auto& s = m_stats[pc];
+        s.loads++;
+
+        if (not e.valid || e.pc != pc) {
+            e = Entry{true, pc, idx, 0, 0};
+            return;
+        }
+
+        auto stride = static_cast<int32_t>(idx - e.last);
+        if (e.confidence >= 2) {
+            s.confident++;
+            if (stride == e.stride)
+                s.correct++;
+        }
+
+        if (stride == e.stride) {
+            if (e.confidence < 3)
+                e.confidence++;
+        } else if (e.confidence > 0) {
+            e.confidence--;
+        } else {
+            e.stride = stride;
+        }
+        e.last = idx;
+
+        if (e.confidence < 2 || e.stride == 0)
+            return;
+
+        s.stride = e.stride;
+        auto line = idx / LINE_WORDS;
+        for (int d = 1; d <= m_degree; d++) {
+            auto l = (idx + static_cast<uint32_t>(e.stride * d)) / LINE_WORDS;
+            if (l != line && (lines.empty() || lines.back() != l))
+                lines.push_back(l);
+        }
+    }
+
+    void dumpDetail(std::ostream& os) const override
+    {
+        os << "# " << name() << " per PC : loads, confident, correct, stride"
+           << std::endl;
+        for (const auto& p : m_stats) {
+            const auto& s = p.second;
+            os << p.first << " : " << s.loads << ' ' << s.confident << ' '
+               << s.correct << ' ' << s.stride << std::endl;
+        }
+    }
+
+private:
+    static constexpr size_t TABLE_SIZE = 256;
+
+    struct Entry {
+        bool valid;
+        uint32_t pc;
+        uint32_t last;
+        int32_t stride;
+        int confidence;
+    };
+    std::vector<Entry> m_table = std::vector<Entry>(TABLE_SIZE, Entry{});
+
+    struct PCStats {
+        int64_t loads = 0;
+        int64_t confident = 0;  // loads predicted
+        int64_t correct = 0;    // of 'confident', at the predicted stride
+        int32_t stride = 0;     // last stride prefetched with
+    };
+    std::map<uint32_t, PCStats> m_stats;
+
+    const int m_degree;
+};
+
+}  // namespace
+
+std::unique_ptr<Prefetcher> Prefetcher::create(const std::string& spec)
+{
+    auto colon = spec.find(':');
+    auto kind = spec.substr(0, colon);
+    int degree = 1;
+    if (colon != std::string::npos) {
+        degree = std::atoi(spec.c_str() + colon + 1);
+        if (degree <= 0)
+            return nullptr;
+    }
+
+    if (kind == "next-line")
+        return std::unique_ptr<Prefetcher>{new NextLinePrefetcher{spec, degree}};
+    if (kind == "stride")
+        return std::unique_ptr<Prefetcher>{new StridePrefetcher{spec, degree}};
+    return nullptr;
+}
+
+PrefetchEvaluator::PrefetchEvaluator(const std::string& specs)
+{
+    m_lanes.emplace_back();  // baseline
+
+    size_t begin = 0;
+    while (begin <= specs.size()) {
+        auto end = std::min(specs.find(',', begin), specs.size());
+        auto spec = specs.substr(begin, end - begin);
+        begin = end + 1;
+        if (spec.empty() || spec == "none")
+            continue;
+
+        auto prefetcher = Prefetcher::create(spec);
+        if (not prefetcher)
+            FAIL("# Error: Unknown prefetcher: " << spec);
+        m_lanes.emplace_back();
+        m_lanes.back().prefetcher = std::move(prefetcher);
+    }
+
+    for (auto& lane : m_lanes)
+        lane.ways.resize(CACHE_LINES);
+}
+
+PrefetchEvaluator::Way* PrefetchEvaluator::find(Lane& lane, uint32_t line)
+{
+    auto set = lane.ways.data() + (line % (CACHE_LINES / WAYS)) * WAYS;
+    for (uint32_t w = 0; w < WAYS; w++) {
+        if (set[w].valid && set[w].line == line)
+            return set + w;
+    }
+    return nullptr;
+}
+
+PrefetchEvaluator::Way& PrefetchEvaluator::victim(Lane& lane, uint32_t line)
+{
+    auto set = lane.ways.data() + (line % (CACHE_LINES / WAYS)) * WAYS;
+    auto v = set;
+    for (uint32_t w = 0; w < WAYS; w++) {
+        if (not set[w].valid)
+            return set[w];
+        if (set[w].used < v->used)
+            v = set + w;
+    }
+    return *v;
+}
+
+void PrefetchEvaluator::access(uint32_t pc, uint32_t idx, bool store, int64_t now)
+{
+    auto line = idx / Prefetcher::LINE_WORDS;
+
+    for (auto& lane : m_lanes) {
+        auto& stats = lane.stats;
+        stats.accesses++;
+
+        auto way = find(lane, line);
+        if (way == nullptr) {
+            stats.misses++;
+            way = &victim(lane, line);
+            way->line = line;
+            way->valid = true;
+            way->prefetched = false;
+        } else if (way->prefetched) {
+            way->prefetched = false;
+            stats.useful++;
+            if (way->ready > now)
+                stats.late++;
+        }
+        way->used = ++lane.clock;
+
+        if (store || not lane.prefetcher)
+            continue;
+
+        m_lines.clear();
+        lane.prefetcher->train(pc, idx, m_lines);
+        for (auto l : m_lines) {
+            if (find(lane, l) != nullptr)
+                continue;
+            auto& w = victim(lane, l);
+            w.line = l;
+            w.valid = true;
+            w.prefetched = true;
+            w.ready = now + LATENCY;
+            w.used = ++lane.clock;
+            stats.issued++;
+        }
+    }
+}
+
+void PrefetchEvaluator::dump(std::ostream& os) const
+{
+    using namespace std;
+
+    auto ratio = [](int64_t a, int64_t b) {
+        char buf[32];
+        snprintf(buf, sizeof buf, "%.4f",
+            b > 0 ? static_cast<double>(a) / static_cast<double>(b) : 0.0);
+        return string{buf};
+    };
+
+    os << "# line = " << Prefetcher::LINE_WORDS << " words, cache = "
+       << CACHE_LINES << " lines, " << WAYS << "-way LRU, latency = " << LATENCY
+       << " insts" << endl;
+    os << "# prefetcher : accesses, misses, issued, useful, late,"
+          " coverage, accuracy, timeliness"
+       << endl;
+    for (const auto& lane : m_lanes) {
+        const auto& s = lane.stats;
+        os << (lane.prefetcher ? lane.prefetcher->name() : "none") << " : "
+           << s.accesses << ' ' << s.misses << ' ' << s.issued << ' '
+           << s.useful << ' ' << s.late << ' '
+           << ratio(s.useful, s.useful + s.misses) << ' '
+           << ratio(s.useful, s.issued) << ' '
+           << ratio(s.useful - s.late, s.useful) << endl;
+    }
+
+    for (const auto& lane : m_lanes) {
+        if (lane.prefetcher)
+            lane.prefetcher->dumpDetail(os);
+    }
+}
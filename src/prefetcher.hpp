@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Hardware prefetcher.
+ * Trained with the demand loads, it returns the lines to prefetch.
+ * Addresses are memory word indices, and lines are indices divided by
+ * LINE_WORDS.
+ */
+class Prefetcher
+{
+public:
+    static constexpr uint32_t LINE_WORDS = 8;
+
+    explicit Prefetcher(std::string name) : m_name(std::move(name)) {}
+    virtual ~Prefetcher() = default;
+
+    const std::string& name() const { return m_name; }
+
+    // Push the lines to prefetch after a load of 'idx' at 'pc' into 'lines'
+    virtual void train(uint32_t pc, uint32_t idx, std::vector<uint32_t>& lines) = 0;
+
+    // Statistics of the prefetcher itself, if any
+    virtual void dumpDetail(std::ostream&) const {}
+
+    /*
+     * "none", "next-line[:degree]" or "stride[:degree]".
+     * Returns nullptr for an unknown name.
+     */
+    static std::unique_ptr<Prefetcher> create(const std::string& spec);
+
+private:
+    const std::string m_name;
+};
+
+/*
+ * Run each prefetcher on a cache of its own, and compare them.
+ * Every demand access goes to all the caches, and the prefetched lines
+ * arrive LATENCY instructions after they are issued.
+ * The first lane has no prefetcher, as the baseline.
+ *
+ * - coverage: accesses to prefetched lines / (those + misses)
+ * - accuracy: prefetched lines used / prefetches issued
+ * - timeliness: prefetched lines which arrived before their first use /
+ *   prefetched lines used
+ * A prefetched line used before its arrival is counted as late, not as a
+ * miss.
+ */
+class PrefetchEvaluator
+{
+public:
+    static constexpr uint32_t CACHE_LINES = 1024;
+    static constexpr uint32_t WAYS = 4;
+    static constexpr int64_t LATENCY = 100;
+
+    // Comma-separated specs of Prefetcher::create()
+    explicit PrefetchEvaluator(const std::string& specs);
+
+    void access(uint32_t pc, uint32_t idx, bool store, int64_t now);
+
+    void dump(std::ostream&) const;
+
+private:
+    struct Way {
+        uint32_t line;
+        bool valid = false;
+        bool prefetched = false;  // not used since prefetched
+        int64_t ready;            // arrival of a prefetched line
+        uint64_t used;            // LRU stamp
+    };
+
+    struct Stats {
+        int64_t accesses = 0;
+        int64_t misses = 0;
+        int64_t issued = 0;  // prefetches of lines not in the cache
+        int64_t useful = 0;  // prefetched lines used
+        int64_t late = 0;    // of 'useful', used before the arrival
+    };
+
+    struct Lane {
+        std::unique_ptr<Prefetcher> prefetcher;  // nullptr: baseline
+        std::vector<Way> ways;                   // CACHE_LINES / WAYS sets
+        Stats stats;
+        uint64_t clock = 0;
+    };
+
+    std::vector<Lane> m_lanes;
+    std::vector<uint32_t> m_lines;  // buffer for Prefetcher::train()
+
+    // The way holding 'line', or nullptr
+    static Way* find(Lane&, uint32_t line);
+    static Way& victim(Lane&, uint32_t line);
+};
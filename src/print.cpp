@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
@@ -46,12 +47,12 @@ void Simulator::printState() const
 {
     {  // status
         std::ostringstream oss;
-        oss << '[' << m_binfile_name;
+        oss << '[' << m_image->binfile_name;
         if (m_infile.is_open())
             oss << " < " << m_infile_name;
         oss << "] ["
             << std::setw(6) << m_codes.size() << '/'
-            << std::setw(11) << m_dynamic_inst_cnt
+            << std::setw(11) << m_cnt.dynamic_inst
             << " instr] ";
 
         auto len = oss.str().size();
@@ -154,9 +155,8 @@ void Simulator::printCode() const
         addstr(" | ");
 
         if (not asserting) {
-            auto asm_ = disasm(code);
-            asm_.resize(m_screen.width - 49, ' ');
-            addstr(asm_.c_str());
+            int asm_len = std::max(m_screen.width - 49, 0);
+            printw("%-*.*s", asm_len, asm_len, m_image->disasm(c));
         }
         addch('\n');
 
@@ -180,19 +180,56 @@ void Simulator::printBreakPoints() const
 {
     if (m_breakpoints.size() == 0)
         addstr("No breakpoint");
-    for (auto b : m_breakpoints)
-        printw("%lld(delay %lld), ", b.first, b.second);
+    for (const auto& b : m_breakpoints) {
+        printw("%lld(delay %lld", b.first, b.second.delay);
+        if (not b.second.cond.empty())
+            printw(" if %s", b.second.cond.source().c_str());
+        addstr("), ");
+    }
+    refresh();
+}
+
+void Simulator::printWatchPoints() const
+{
+    if (m_watchpoints.size() == 0)
+        addstr("No watchpoint");
+    for (const auto& w : m_watchpoints)
+        printw("%s[%zu, %zu), ", w.store ? "watch" : "rwatch", w.begin, w.end);
+    refresh();
+}
+
+void Simulator::printWatchHit() const
+{
+    const auto& h = m_watch_hit;
+    if (h.store) {
+        printw("Watchpoint: PC %u stored memory[%zu] = 0x%x (was 0x%x)",
+            h.pc, h.idx, m_memory[h.idx], h.preval);
+    } else {
+        printw("Watchpoint: PC %u loaded memory[%zu] = 0x%x",
+            h.pc, h.idx, h.preval);
+    }
     refresh();
 }
 
 void Simulator::printMemory(size_t idx) const
 {
     auto min = idx >= 3 ? idx - 3 : 0;
-    auto max = idx <= m_memory_num - 3
-                   ? idx + 3
-                   : m_memory_num;
+    // The word after the last one is the guard region
+    auto max = std::min(idx + 3, m_memory_num - 1);
     for (size_t i = min; i <= max; i++) {
         printw("memory[%zu] = 0x%x", i, m_memory[i]);
+        if (not m_writers.empty()) {
+            for (size_t d = 0; d < m_writer_depth; d++) {
+                auto w = m_writers.at(i * m_writer_depth + d);
+                if (w == 0)
+                    break;
+                printw("%s PC %llu @ %llu", d == 0 ? "  written by" : ",",
+                    static_cast<unsigned long long>(
+                        ((w >> WRITER_CNT_BITS) - 1) * 4),
+                    static_cast<unsigned long long>(
+                        w & ((1ull << WRITER_CNT_BITS) - 1)));
+            }
+        }
         if (i < max)
             addch('\n');
     }
@@ -208,10 +245,13 @@ void Simulator::printHelp() const
 
     PRINT_CMD_DESC("run|r", ": run to the 'halt', ");
     PRINT_CMD_DESC("reset", ": reset\n");
-    PRINT_CMD_DESC("(break|b) [int]", ": set breakpoint, ");
+    PRINT_CMD_DESC("(break|b) [int] <int> <if [cond]>", ": set breakpoint, ");
     PRINT_CMD_DESC("pb", ": show breakpoints, ");
     PRINT_CMD_DESC("db [int]", ": delete breakpoint\n");
     PRINT_CMD_DESC("pm [int]", ": show memory\n");
+    PRINT_CMD_DESC("(watch|rwatch) [int] <int>", ": set write/read watchpoint, ");
+    PRINT_CMD_DESC("pw", ": show watchpoints, ");
+    PRINT_CMD_DESC("dw [int]", ": delete watchpoint\n");
     PRINT_CMD_DESC("(step|s) <int>", ": next instruction, ");
     PRINT_CMD_DESC("prev|p", ": rewind to previous instruction\n");
     PRINT_CMD_DESC("log|l", ": dump statistics log, ");
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include "reuse_distance.hpp"
+
+constexpr int64_t ReuseDistance::COLD;
+constexpr uint32_t ReuseDistance::NONE;
+
+ReuseDistance::ReuseDistance(size_t line_num)
+    : m_last(line_num, NONE),
+      m_owner(std::max<size_t>(2 * line_num, 1 << 16)),
+      m_tree(m_owner.size() + 1)
+{
+}
+
+int64_t ReuseDistance::access(size_t line)
+{
+    if (m_now == m_owner.size())
+        compact();
+
+    auto last = m_last[line];
+    int64_t distance = COLD;
+    if (last != NONE) {
+        distance = m_marks - prefix(last);
+        add(last, -1);
+        m_marks--;
+    }
+
+    m_last[line] = m_now;
+    m_owner[m_now] = static_cast<uint32_t>(line);
+    add(m_now, 1);
+    m_marks++;
+    m_now++;
+
+    return distance;
+}
+
+void ReuseDistance::add(uint32_t time, int32_t v)
+{
+    for (size_t i = time + 1; i < m_tree.size(); i += i & (~i + 1))
+        m_tree[i] += v;
+}
+
+int64_t ReuseDistance::prefix(uint32_t time) const
+{
+    int64_t sum = 0;
+    for (size_t i = time + 1; i > 0; i -= i & (~i + 1))
+        sum += m_tree[i];
+    return sum;
+}
+
+// Renumber the marks to [0, m_marks) keeping their order
+void ReuseDistance::compact()
+{
+    uint32_t n = 0;
+    for (uint32_t t = 0; t < m_now; t++) {
+        auto line = m_owner[t];
+        if (m_last[line] == t) {
+            m_last[line] = n;
+            m_owner[n] = line;
+            n++;
+        }
+    }
+    m_now = n;
+
+    // Build the tree of marks on [0, n) in linear time
+    std::fill(m_tree.begin(), m_tree.end(), 0);
+    for (size_t i = 1; i <= n; i++)
+        m_tree[i] = 1;
+    for (size_t i = 1; i < m_tree.size(); i++) {
+        auto j = i + (i & (~i + 1));
+        if (j < m_tree.size())
+            m_tree[j] += m_tree[i];
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * LRU stack distance of memory accesses.
+ * The distance of an access is the number of distinct lines accessed since
+ * the last access to the same line, so that an access hits in a fully
+ * associative LRU cache of n lines iff its distance is less than n.
+ *
+ * Each line keeps the time of its last access, and a Fenwick tree over the
+ * times marks the last access of every line. The distance is the number of
+ * marks after the last access of the line, in O(log capacity).
+ * When the times reach the capacity, the marks are renumbered in order, so
+ * that the memory stays proportional to the number of lines.
+ */
+class ReuseDistance
+{
+public:
+    explicit ReuseDistance(size_t line_num);
+
+    static constexpr int64_t COLD = -1;  // first access to the line
+
+    int64_t access(size_t line);
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    std::vector<uint32_t> m_last;   // time of the last access of each line
+    std::vector<uint32_t> m_owner;  // line accessed at each time
+    std::vector<int32_t> m_tree;    // Fenwick tree of the marks, 1-origin
+    uint32_t m_now = 0;
+    int64_t m_marks = 0;
+
+    void add(uint32_t time, int32_t v);
+    int64_t prefix(uint32_t time) const;  // marks in [0, time]
+    void compact();
+};
@@ -0,0 +1,55 @@
+#include <cstdlib>
+#include "util.hpp"
+#include "simulator.hpp"
+
+constexpr Simulator::Instruction Simulator::ROI_BEGIN_NOP;
+constexpr Simulator::Instruction Simulator::ROI_END_NOP;
+
+/*
+ * "nop": the ROI runs from each ROI_BEGIN_NOP to the next ROI_END_NOP.
+ * "<begin>:<end>": the ROI runs from each arrival at the PC 'begin' to the
+ * next arrival at 'end', which is outside the ROI.
+ */
+void Simulator::markRoi(const std::string& spec)
+{
+    m_marked.assign(m_fused, m_fused + m_codes.size());
+
+    auto mark = [this, &spec](size_t idx, FusedOp op) {
+        if (idx >= m_marked.size())
+            FAIL("# Error: ROI marker out of the program: " << spec);
+        m_marked[idx] = op;
+        // A pair would run past the marker
+        if (idx > 0 && m_marked[idx - 1] < FusedOp::ROI_BEGIN)
+            m_marked[idx - 1] = FusedOp::NONE;
+    };
+
+    if (spec == "nop") {
+        for (size_t idx = 0; idx < m_codes.size(); idx++) {
+            if (m_codes[idx] == ROI_BEGIN_NOP)
+                mark(idx, FusedOp::ROI_BEGIN);
+            else if (m_codes[idx] == ROI_END_NOP)
+                mark(idx, FusedOp::ROI_END);
+        }
+    } else {
+        char* colon;
+        auto begin = std::strtoul(spec.c_str(), &colon, 0);
+        char* last;
+        auto end = *colon == ':' ? std::strtoul(colon + 1, &last, 0) : 0;
+        if (*colon != ':' || *last != '\0' || begin % 4 != 0 || end % 4 != 0
+            || begin == end)
+            FAIL("# Error: Invalid ROI: " << spec);
+        mark(begin / 4, FusedOp::ROI_BEGIN);
+        mark(end / 4, FusedOp::ROI_END);
+    }
+
+    m_fused = m_marked.data();
+}
+
+void Simulator::runRoi(const RunToHalt table[])
+{
+    auto detailed = table[execFlags()];
+    auto fast = table[execFlags() & (EXEC_CHECKED | EXEC_HW_FPU)];
+
+    while (not m_halt)
+        runChunks(m_in_roi ? detailed : fast);
+}
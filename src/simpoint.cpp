@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "util.hpp"
+#include "simulator.hpp"
+
+/*
+ * The output of tools/simpoint.py:
+ *   # interval = <instructions>
+ *   <interval index> <weight>
+ *   ...
+ */
+void Simulator::loadSimPoints(const std::string& file)
+{
+    std::ifstream ifs{file};
+    if (ifs.fail())
+        FAIL("# Error: File " << file << " couldn't be opened");
+
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.empty())
+            continue;
+        if (line[0] == '#') {
+            long long len;
+            if (sscanf(line.c_str(), "# interval = %lld", &len) == 1)
+                m_simpoint_len = len;
+            continue;
+        }
+
+        std::istringstream iss{line};
+        SimPoint p;
+        if (not(iss >> p.interval >> p.weight) || p.interval < 0
+            || p.weight < 0)
+            FAIL("# Error: Invalid simulation point in " << file << ": "
+                                                         << line);
+        m_simpoints.push_back(p);
+    }
+
+    if (m_simpoint_len <= 0)
+        FAIL("# Error: No interval length in " << file);
+    if (m_simpoints.empty())
+        FAIL("# Error: No simulation point in " << file);
+
+    std::sort(m_simpoints.begin(), m_simpoints.end(),
+        [](const SimPoint& a, const SimPoint& b) {
+            return a.interval < b.interval;
+        });
+}
+
+void Simulator::runSimPoints(const RunToHalt table[])
+{
+    auto detailed = table[execFlags()];
+    auto fast = table[execFlags() & (EXEC_CHECKED | EXEC_HW_FPU)];
+
+    // Counters of each interval run, without dynamic_inst
+    std::vector<Counters> counters;
+    std::vector<double> weights;
+
+    for (const auto& p : m_simpoints) {
+        auto begin = p.interval * m_simpoint_len;
+        runTo(fast, begin);
+        if (m_halt || m_cnt.dynamic_inst < begin)
+            break;
+
+        auto dynamic_inst = m_cnt.dynamic_inst;
+        m_cnt.clear();
+        m_cnt.dynamic_inst = dynamic_inst;
+        runTo(detailed, begin + m_simpoint_len);
+
+        counters.push_back(m_cnt);
+        counters.back().dynamic_inst = 0;
+        weights.push_back(p.weight);
+        if (m_halt)
+            break;
+    }
+    if (not m_halt)
+        runTo(fast, INT64_MAX);
+
+    auto dynamic_inst = m_cnt.dynamic_inst;
+    auto interval_num = std::ceil(static_cast<double>(dynamic_inst)
+                                  / static_cast<double>(m_simpoint_len));
+    m_cnt.clear();
+    for (size_t i = 0; i < counters.size(); i++) {
+        counters[i].scale(weights[i] * interval_num);
+        m_cnt.merge(counters[i]);
+    }
+    m_cnt.dynamic_inst = dynamic_inst;
+    m_cnt.simpoints = static_cast<int64_t>(counters.size());
+}
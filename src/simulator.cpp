@@ -1,97 +1,157 @@
+#include <algorithm>
 #include <exception>
 #include "util.hpp"
 #include "simulator.hpp"
 
-Simulator::Simulator(
-    const std::string& binfile,
-    const std::string& infile,
-    const std::string& outfile,
-    size_t memory_num,
-    bool interactive,
-    bool output_memory,
-    bool prev_disable,
-    bool quit_run)
-    : m_binfile_name(binfile),
-      m_infile_name(infile),
-      m_memory_num(memory_num),
-      m_interactive(interactive),
-      m_output_memory(output_memory),
-      m_prev_disable(prev_disable || (not interactive)),
-      m_quit_run(quit_run),
-      m_refresh_inst_cnt(m_interactive ? 1 << 24 : 1 << 25)
+std::shared_ptr<const Simulator::ProgramImage> Simulator::loadImage(
+    const std::string& binfile, const std::string& cache_dir)
 {
-    initDisassembler();
+    HostProfiler::Scope scope{HostProfiler::LOAD};
+
+    auto image = std::make_shared<ProgramImage>();
+    image->binfile_name = binfile;
+    readImage(*image, binfile);
+    if (not cache_dir.empty() && loadCachedImage(*image, cache_dir))
+        return image;
+
+    auto analysis = std::make_shared<ProgramImage::Analysis>();
+    const auto& codes = image->codes;
+    analysis->opcodes.reserve(codes.size());
+    for (auto inst : codes)
+        analysis->opcodes.emplace_back(decodeOpCode(inst));
+    analysis->pc_check = verify(codes, analysis->opcodes);
+    analysis->fused = fuse(analysis->opcodes);
+    findLoops(codes, *analysis);
+
+    auto& asm_text = analysis->asm_text;
+    analysis->asm_offset.reserve(codes.size());
+    for (auto inst : codes) {
+        char buf[DISASM_LEN_MAX];
+        auto len = disasm(inst, buf, sizeof buf);
+        analysis->asm_offset.emplace_back(asm_text.size());
+        asm_text.insert(asm_text.end(), buf, buf + len + 1);
+    }
+    image->setAnalysis(std::move(analysis));
 
-    m_binfile.open(binfile, std::ios::binary);
-    if (m_binfile.fail())
-        FAIL("# Error: File " << binfile << " couldn't be opened");
+    if (not cache_dir.empty())
+        saveCachedImage(*image, cache_dir);
+    return image;
+}
 
-    if (not infile.empty()) {
-        m_infile.open(infile);
+Simulator::Simulator(
+    std::shared_ptr<const ProgramImage> image, const Config& config)
+    : m_image(std::move(image)),
+      m_codes(m_image->codes),
+      m_infile_name(config.infile),
+      m_memory_num(config.memory_num),
+      m_interactive(config.interactive),
+      m_checked(config.checked),
+      m_output_memory(config.output_memory),
+      m_prev_disable(config.prev_disable || (not config.interactive)),
+      m_quit_run(config.quit_run),
+      m_sampling(config.sample_hz > 0),
+      m_hw_fpu(config.hw_fpu),
+      m_loop_profile(config.loop_profile),
+      m_interval_len(std::max<int64_t>(config.interval, 0)),
+      m_collect_bbv(config.bbv),
+      m_binary_stats(config.binary_stats),
+      m_refresh_inst_cnt(m_interactive ? 1 << 24 : 1 << 25),
+      m_reuse_line(static_cast<size_t>(std::max(config.reuse_line, 0))),
+      m_prefetchers(config.prefetchers),
+      m_writer_depth(static_cast<size_t>(std::max(config.writer_depth, 0)))
+{
+    HostProfiler::Scope scope{HostProfiler::LOAD};
+
+    if (not m_infile_name.empty()) {
+        m_infile.open(m_infile_name);
         if (m_infile.fail())
-            FAIL("# Error: File " << infile << " couldn't be opened");
+            FAIL("# Error: File " << m_infile_name << " couldn't be opened");
     }
 
-    m_outfile.open(outfile);
+    m_outfile.open(config.outfile);
     if (m_outfile.fail())
-        FAIL("# Error: File " << outfile << " couldn't be opened for writing");
-
-    m_memory = static_cast<int32_t*>(
-        std::malloc(sizeof(int32_t) * m_memory_num));
-    if (m_memory == NULL)
-        FAIL("# Error: Memory couldn't malloc'ed");
+        FAIL("# Error: File " << config.outfile
+                              << " couldn't be opened for writing");
+
+    m_guarded_memory.reset(new GuardedMemory{m_memory_num, &m_pc});
+    m_memory = m_guarded_memory->data();
+    loadSegments();
+
+    if (m_writer_depth > 0)
+        m_writers.resize(m_memory_num * m_writer_depth);
+
+    // During a fused pair the PC stays on the first code, so PC samples
+    // would never land on the second one
+    if (config.fuse && not m_sampling) {
+        m_fused = m_image->fused.data();
+    } else {
+        m_unfused.resize(m_codes.size(), FusedOp::NONE);
+        m_fused = m_unfused.data();
+    }
+    if (not config.roi.empty())
+        markRoi(config.roi);
 
-    constexpr size_t CODE_RESERVE_SIZE = 1 << 12;
-    m_codes.reserve(CODE_RESERVE_SIZE);
-    Instruction r;
-    while (m_binfile.read(reinterpret_cast<char*>(&r), sizeof r)) {
-        m_codes.emplace_back(r);
+    m_cnt.pc_called.resize(m_codes.size());
+    if (m_loop_profile) {
+        m_cnt.loops.resize(m_image->loops.size());
+        indexLoops();
+    }
+    if (m_reuse_line > 0) {
+        auto line_num = (m_memory_num + m_reuse_line - 1) / m_reuse_line;
+        m_reuse.reset(new ReuseDistance{line_num});
+        m_cnt.reuse_hist.resize(line_num);
     }
-    m_pc_called_cnt.resize(m_codes.size());
+    if (not m_prefetchers.empty())
+        m_prefetch.reset(new PrefetchEvaluator{m_prefetchers});
+    if (m_interval_len > 0)
+        beginIntervals();
+    if (not config.simpoints.empty())
+        loadSimPoints(config.simpoints);
+    m_break_flags.resize(m_codes.size());
+    if (m_sampling)
+        m_sampler.reset(new PCSampler{&m_pc, m_codes.size(), config.sample_hz});
+    if (not config.metrics.empty())
+        openMetrics(config.metrics);
 
     m_state_hist.push(PreState{});
     m_state_hist_iter = m_state_hist.deque.begin();
 }
 
-Simulator::~Simulator() { std::free(m_memory); }
-
 void Simulator::run()
 {
-    int64_t step_cnt = 0;
+    HostProfiler::Scope scope{HostProfiler::UI};
     m_start_time = std::chrono::high_resolution_clock::now();
+    if (m_metrics)
+        publishMetrics();
 
-    while (true) {
-        if (not m_interactive) {
-            if (m_halt) {
-                printConsole();
-                addstr("finished\n");
-                refresh();
-                while (!m_quit_run) {
-                    int key = getch();
-                    if (key == 'q')
-                        break;
-                }
-                return;
-            }
-            if (m_dynamic_inst_cnt % m_refresh_inst_cnt == 0) {
-                printConsole();
-                refresh();
-            }
-        } else if (step_cnt > 0) {
-            step_cnt--;
-        } else if (m_running) {
-            if (m_dynamic_inst_cnt % m_refresh_inst_cnt == 0) {
-                printConsole();
-                refresh();
-            }
-        } else {
+    if (not m_interactive) {
+        m_running = true;
+        while (true) {
             printConsole();
-            // Input command
-            addstr(">> ");
+            if (not m_running)
+                break;
             refresh();
+            execute(m_refresh_inst_cnt);
+        }
+
+        addstr("finished\n");
+        refresh();
+        while (!m_quit_run) {
+            int key = getch();
+            if (key == 'q')
+                break;
+        }
+        return;
+    }
+
+    while (true) {
+        printConsole();
+        // Input command
+        addstr(">> ");
+        refresh();
 
-            char input[64];
-            getnstr(input, 64);
+        char input[64];
+        getnstr(input, 64);
 
 #define PRINT_ERROR(msg) \
     do {                 \
@@ -100,198 +160,521 @@ void Simulator::run()
         getch();         \
     } while (0)
 
-            if ((streq(input, "run") || streq(input, "r")) && not m_halt) {
-                m_running = true;
-            } else if (streq(input, "reset")) {
-                reset();
-                continue;
-            } else if (streqn(input, "break", 5)) {
-                inputBreakpoint(input + 5);
-                continue;
-            } else if (streqn(input, "b", 1)) {
-                inputBreakpoint(input + 1);
-                continue;
-            } else if (streq(input, "pb")) {
-                printBreakPoints();
-                getch();
+        if ((streq(input, "run") || streq(input, "r")) && not m_halt) {
+            runInteractive(-1);
+        } else if (streqn(input, "watch", 5)) {
+            inputWatchpoint(input + 5, true);
+        } else if (streqn(input, "rwatch", 6)) {
+            inputWatchpoint(input + 6, false);
+        } else if (streq(input, "pw")) {
+            printWatchPoints();
+            getch();
+        } else if (streqn(input, "dw", 2)) {
+            size_t w;
+            if (sscanf(input + 2, "%zu", &w) != 1)
+                PRINT_ERROR("# Error: Invalid watchpoint format");
+            else
+                deleteWatchpoint(w);
+        } else if (streq(input, "reset")) {
+            reset();
+        } else if (streqn(input, "break", 5)) {
+            inputBreakpoint(input + 5);
+        } else if (streqn(input, "b", 1)) {
+            inputBreakpoint(input + 1);
+        } else if (streq(input, "pb")) {
+            printBreakPoints();
+            getch();
+        } else if (streqn(input, "db", 2)) {
+            int b;
+            if (sscanf(input + 2, "%d", &b) != 1) {
+                PRINT_ERROR("# Error: Invalid breakpoint format");
+            } else {
+                m_breakpoints.erase(b);
+                if (b >= 0 && b % 4 == 0
+                    && static_cast<size_t>(b / 4) < m_break_flags.size())
+                    m_break_flags[b / 4] = false;
+            }
+        } else if ((streqn(input, "step", 4) || streqn(input, "s", 1))
+                   && not m_halt) {
+            int64_t s = 1;
+            auto arg = input + (streqn(input, "step", 4) ? 4 : 1);
+            if (sscanf(arg, "%ld", &s) == 1 && s <= 0)
+                PRINT_ERROR("# Error: Invalid step format");
+            else
+                runInteractive(s);
+        } else if (not m_prev_disable
+                   && (streq(input, "prev") || streq(input, "p"))) {
+            if (m_state_hist_iter == m_state_hist.deque.begin()) {
+                PRINT_ERROR("# Error: Out of saved history");
                 continue;
-            } else if (streqn(input, "db", 2)) {
-                int b;
-                if (sscanf(input + 2, "%d", &b) != 1) {
-                    PRINT_ERROR("# Error: Invalid breakpoint format");
-                } else {
-                    m_breakpoints.erase(b);
-                }
+            } else {
+                const auto& pc = m_state_hist_iter->pc;
+                if (pc.changed)
+                    m_pc = pc.preval;
 
-                continue;
-            } else if (streqn(input, "step", 4) && not m_halt) {
-                int64_t s = 0;
-                if (sscanf(input + 4, "%lld", &s) == 1) {
-                    if (s <= 0) {
-                        PRINT_ERROR("# Error: Invalid step format");
-                    } else {
-                        step_cnt = s - 1;
-                    }
-                }
-            } else if (streqn(input, "s", 1) && not m_halt) {
-                int64_t s = 0;
-                if (sscanf(input + 1, "%lld", &s) == 1) {
-                    if (s <= 0) {
-                        PRINT_ERROR("# Error: Invalid step format");
-                    } else {
-                        step_cnt = s - 1;
-                    }
-                }
-            } else if (not m_prev_disable
-                       && (streq(input, "prev") || streq(input, "p"))) {
-                if (m_state_hist_iter == m_state_hist.deque.begin()) {
-                    PRINT_ERROR("# Error: Out of saved history");
-                    continue;
-                } else {
-                    const auto& pc = m_state_hist_iter->pc;
-                    if (pc.changed)
-                        m_pc = pc.preval;
-
-                    const auto& gpreg = m_state_hist_iter->gpreg;
-                    if (gpreg.changed)
-                        m_reg.at(gpreg.idx) = gpreg.preval;
-
-                    const auto& freg = m_state_hist_iter->freg;
-                    if (freg.changed)
-                        m_freg.at(freg.idx) = freg.preval;
-
-                    const auto& mem = m_state_hist_iter->mem;
-                    if (mem.changed)
-                        m_memory[mem.idx] = mem.preval;
-
-                    m_state_hist_iter--;
-                }
+                const auto& gpreg = m_state_hist_iter->gpreg;
+                if (gpreg.changed)
+                    m_reg.at(gpreg.idx) = gpreg.preval;
 
-                m_halt = false;
-                continue;
-            } else if (streqn(input, "pm", 2)) {
-                size_t idx;
-                if (sscanf(input + 2, "%zu", &idx) == 0)
-                    addstr("# Error: Invalid memory index format");
-                else {
-                    checkMemoryIndex(idx);
-                    printMemory(idx);
-                }
-                refresh();
-                getch();
-                continue;
-            } else if (streq(input, "log") or streq(input, "l")) {
-                dumpLog();
-                getch();
-                continue;
-            } else if (streq(input, "quit") or streq(input, "q")) {
-                return;
-            } else if (streq(input, "help") or streq(input, "h")) {
-                printHelp();
-                getch();
-                continue;
-            } else {
-                continue;
+                const auto& freg = m_state_hist_iter->freg;
+                if (freg.changed)
+                    m_freg.at(freg.idx) = freg.preval;
+
+                const auto& mem = m_state_hist_iter->mem;
+                if (mem.changed)
+                    m_memory[mem.idx] = mem.preval;
+
+                m_state_hist_iter--;
+            }
+
+            m_halt = false;
+        } else if (streqn(input, "pm", 2)) {
+            size_t idx;
+            if (sscanf(input + 2, "%zu", &idx) == 0)
+                addstr("# Error: Invalid memory index format");
+            else {
+                if (idx >= m_memory_num)
+                    FAIL("# Error: Memory index out of range: " << idx);
+                printMemory(idx);
             }
+            refresh();
+            getch();
+        } else if (streq(input, "log") or streq(input, "l")) {
+            dumpLog();
+            getch();
+        } else if (streq(input, "quit") or streq(input, "q")) {
+            return;
+        } else if (streq(input, "help") or streq(input, "h")) {
+            printHelp();
+            getch();
         }
+    }
+}
 
-        if (not m_halt) {  // next instruction
-            auto pc_idx = m_pc / 4;
-#ifndef FELIS_SIM_NO_ASSERT
-            if (m_codes.size() <= pc_idx)
-                FAIL("# Error: Program counter out of range");
-#endif
-            Instruction inst = m_codes[pc_idx];  // fetch
-            auto opcode = decodeOpCode(inst);
-            auto pre_state = exec(opcode, inst);
-
-            if (not m_prev_disable) {
-                if (m_state_hist_iter == std::prev(m_state_hist.deque.end())) {
-                    m_state_hist_iter = m_state_hist.push(pre_state);
-                    m_pc_called_cnt.at(pc_idx)++;
-                    m_dynamic_inst_cnt++;
-                } else {
-                    m_state_hist_iter++;
-                }
+/*
+ * Execute step_num instructions (-1: unlimited), stopping at HALT or a
+ * breakpoint, with refreshing the screen periodically.
+ */
+void Simulator::runInteractive(int64_t step_num)
+{
+    m_running = true;
+    while (m_running && step_num != 0) {
+        auto n = (step_num < 0 || step_num > m_refresh_inst_cnt)
+                     ? m_refresh_inst_cnt
+                     : step_num;
+        auto executed = execute(n);
+        if (step_num > 0)
+            step_num -= executed;
+
+        if (m_running && step_num != 0) {
+            printConsole();
+            refresh();
+        }
+    }
+    m_running = false;
+
+    if (m_watch_hit.hit) {
+        printConsole();
+        printWatchHit();
+        getch();
+        m_watch_hit.hit = false;
+    }
+}
+
+// Table of member<ExecPolicy<flags>> indexed by flags
+#define EXEC_POLICY_ENTRY(member, _, flags) \
+    &Simulator::member<ExecPolicy<flags>>,
+
+unsigned Simulator::execFlags() const
+{
+    unsigned flags = 0;
+    if (m_checked)
+        flags |= EXEC_CHECKED;
+    if (not m_prev_disable)
+        flags |= EXEC_HISTORY;
+    if (m_output_memory || m_reuse || m_prefetch || m_interval_len > 0)
+        flags |= EXEC_MEM_PROFILE;
+    if (not m_sampling)
+        flags |= EXEC_COUNT;
+    if (m_hw_fpu)
+        flags |= EXEC_HW_FPU;
+    if (m_loop_profile || m_interval_len > 0)
+        flags |= EXEC_PROFILE;
+    return flags;
+}
+
+int64_t Simulator::execute(int64_t n)
+{
+    using Execute = int64_t (Simulator::*)(int64_t);
+    static const Execute table[EXEC_POLICY_NUM] = {
+        FELIS_SIM_FOR_EACH_EXEC_POLICY(EXEC_POLICY_ENTRY, execute, _)};
+
+    HostProfiler::Scope scope{HostProfiler::EXECUTE};
+    int64_t i = 0;
+    m_guarded_memory->run([&]() { i = (this->*table[execFlags()])(n); });
+    if (m_metrics)
+        publishMetrics();
+    return i;
+}
+
+/*
+ * Execute at most n instructions while m_running.
+ * Breakpoints are looked up only when the PC is flagged in m_break_flags.
+ */
+template <class P>
+int64_t Simulator::execute(int64_t n)
+{
+    if (P::checked)
+        checkPC();
+
+    int64_t i = 0;
+    while (i < n && m_running) {
+        auto pc_idx = m_pc / 4;
+        Instruction inst = m_codes[pc_idx];  // fetch
+        auto opcode = m_image->opcodes[pc_idx];
+        auto pre_state = exec<P>(opcode, inst);
+        if (P::checked && m_image->pc_check[pc_idx])
+            checkPC();
+        if (P::profile && m_image->block_end[pc_idx]
+            && (not P::history
+                   || m_state_hist_iter == std::prev(m_state_hist.deque.end())))
+            profileBlockEnd(pc_idx);
+        if (m_halt)
+            dumpLog();
+
+        if (P::history) {
+            if (m_state_hist_iter == std::prev(m_state_hist.deque.end())) {
+                m_state_hist_iter = m_state_hist.push(pre_state);
+                if (P::count)
+                    m_cnt.pc_called[pc_idx]++;
+                m_cnt.dynamic_inst++;
             } else {
-                m_pc_called_cnt.at(pc_idx)++;
-                m_dynamic_inst_cnt++;
+                m_state_hist_iter++;
             }
+        } else {
+            if (P::count)
+                m_cnt.pc_called[pc_idx]++;
+            m_cnt.dynamic_inst++;
+        }
+        i++;
+
+        auto next_idx = m_pc / 4;
+        if (next_idx < m_break_flags.size() && m_break_flags[next_idx])
+            hitBreakpoint();
+    }
+
+    return i;
+}
 
-            if (m_interactive) {  // breakpoint
-                auto bp = m_breakpoints.find(m_pc);
-                if (bp != m_breakpoints.end()) {
-                    if (bp->second == 0)  // break
-                        m_running = false;
-                    else
-                        bp->second--;
+void Simulator::runHeadless()
+{
+    HostProfiler::Scope scope{HostProfiler::EXECUTE};
+    m_start_time = std::chrono::high_resolution_clock::now();
+    if (m_metrics)
+        publishMetrics();
+
+    static const RunToHalt table[EXEC_POLICY_NUM] = {
+        FELIS_SIM_FOR_EACH_EXEC_POLICY(EXEC_POLICY_ENTRY, runToHalt, _)};
+    static const RunToHalt host_table[EXEC_POLICY_NUM] = {
+        FELIS_SIM_FOR_EACH_EXEC_POLICY(EXEC_POLICY_ENTRY, runToHaltHost, _)};
+
+    auto host = HostProfiler::active();
+    if (host != nullptr && host->handlers()) {
+        m_host = host;
+        beginHostHandlers();
+        runChunks(host_table[execFlags()]);
+    } else if (not m_simpoints.empty())
+        runSimPoints(table);
+    else if (not m_marked.empty())
+        runRoi(table);
+    else
+        runChunks(table[execFlags()]);
+}
+
+void Simulator::runTo(RunToHalt run, int64_t limit)
+{
+    m_guarded_memory->run([&]() { (this->*run)(limit); });
+}
+
+void Simulator::runChunks(RunToHalt run)
+{
+    while (true) {
+        auto limit = metricsLimit();
+        runTo(run, limit);
+        if (m_metrics)
+            publishMetrics();
+        // HALT, or an ROI marker
+        if (m_halt || m_cnt.dynamic_inst < limit)
+            return;
+    }
+}
+
+// No history is saved in a headless run, and fused pairs are executed at once
+template <class P>
+void Simulator::runToHalt(int64_t limit)
+{
+    if (P::checked)
+        checkPC();
+
+    while (m_cnt.dynamic_inst < limit) {
+        auto pc_idx = m_pc / 4;
+        auto fused = m_fused[pc_idx];
+        if (fused != FusedOp::NONE) {
+            if (fused >= FusedOp::ROI_BEGIN) {
+                // Return to switch the policy. The marked code runs under
+                // the next one.
+                bool begin = fused == FusedOp::ROI_BEGIN;
+                if (begin != m_in_roi) {
+                    m_in_roi = begin;
+                    return;
                 }
+            } else {
+                execFused<P>(fused, pc_idx);
+                if (P::checked && m_image->pc_check[pc_idx + 1])
+                    checkPC();
+
+                // The profilers see the first code counted, as in execute()
+                if (P::count)
+                    m_cnt.pc_called[pc_idx]++;
+                m_cnt.dynamic_inst++;
+                if (P::profile && m_image->block_end[pc_idx + 1])
+                    profileBlockEnd(pc_idx + 1);
+
+                if (P::count)
+                    m_cnt.pc_called[pc_idx + 1]++;
+                m_cnt.dynamic_inst++;
+                continue;
             }
         }
+
+        exec<P>(m_image->opcodes[pc_idx], m_codes[pc_idx]);
+        if (P::checked && m_image->pc_check[pc_idx])
+            checkPC();
+        if (P::profile && m_image->block_end[pc_idx])
+            profileBlockEnd(pc_idx);
+        if (m_halt)  // HALT itself is not counted, as in run()
+            break;
+
+        if (P::count)
+            m_cnt.pc_called[pc_idx]++;
+        m_cnt.dynamic_inst++;
     }
 }
 
-void Simulator::disasm()
+template <class P>
+void Simulator::runToHaltHost(int64_t limit)
 {
-    int64_t c = 0;
-    for (const auto& inst : m_codes) {
-        printf("%7lld | %s\n", c, disasm(inst).c_str());
-        c += 4;
+    if (P::checked)
+        checkPC();
+
+    while (m_cnt.dynamic_inst < limit) {
+        auto pc_idx = m_pc / 4;
+        auto opcode = m_image->opcodes[pc_idx];
+        auto before = m_host->read();
+        exec<P>(opcode, m_codes[pc_idx]);
+        m_host->addHandler(static_cast<size_t>(opcode), before);
+        if (P::checked && m_image->pc_check[pc_idx])
+            checkPC();
+        if (P::profile && m_image->block_end[pc_idx])
+            profileBlockEnd(pc_idx);
+        if (m_halt)
+            break;
+
+        if (P::count)
+            m_cnt.pc_called[pc_idx]++;
+        m_cnt.dynamic_inst++;
     }
 }
 
-void Simulator::checkMemoryIndex(size_t idx)
+// Name the handlers by the opcodes, as indexed in runToHaltHost()
+void Simulator::beginHostHandlers()
 {
-#ifndef FELIS_SIM_NO_ASSERT
-    if (idx < 0 || idx >= static_cast<int32_t>(m_memory_num))
-        FAIL("# Error: Memory index out of range: " << idx);
-#endif
-
-    if (m_output_memory) {
-        if (m_memory_idx_max < idx)
-            m_memory_idx_max = idx;
+    std::vector<std::string> names;
+    for (const auto& m : mnemonicTable()) {
+        auto op = static_cast<size_t>(m.first);
+        if (names.size() <= op)
+            names.resize(op + 1);
+        names[op] = m.second.mnemonic;
+    }
+    m_host->setHandlerNames(names);
+}
 
-        m_memory_access_cnt[idx]++;
+void Simulator::disasm()
+{
+    constexpr size_t BUF_SIZE = 1 << 16;
+    constexpr int SYMBOL_LEN_MAX = 64;  // longer labels are cut
+    constexpr size_t LINE_LEN_MAX = DISASM_LEN_MAX + SYMBOL_LEN_MAX + 32;
+    std::vector<char> buf(BUF_SIZE);
+
+    size_t len = 0;
+    for (size_t c = 0; c < m_codes.size(); c++) {
+        if (len + LINE_LEN_MAX > BUF_SIZE) {
+            fwrite(buf.data(), 1, len, stdout);
+            len = 0;
+        }
+        auto symbol = m_image->symbols.find(static_cast<uint32_t>(c * 4));
+        if (symbol != m_image->symbols.end())
+            len += static_cast<size_t>(snprintf(buf.data() + len,
+                BUF_SIZE - len, "%.*s:\n", SYMBOL_LEN_MAX,
+                symbol->second.c_str()));
+        len += static_cast<size_t>(snprintf(buf.data() + len, BUF_SIZE - len,
+            "%7llu | %s\n", static_cast<unsigned long long>(c * 4),
+            m_image->disasm(c)));
     }
+    fwrite(buf.data(), 1, len, stdout);
+}
+
+void Simulator::checkPC() const
+{
+    if (m_codes.size() <= m_pc / 4)
+        FAIL("# Error: Program counter out of range");
 }
 
 void Simulator::inputBreakpoint(char* input)
 {
+    // (break|b) [int] <int> <if [condition]>
+    Breakpoint bp;
+    auto cond = std::strstr(input, " if ");
+    if (cond != nullptr) {
+        std::string error;
+        if (not Condition::compile(cond + 4, bp.cond, error)) {
+            error = "# Error: " + error;
+            PRINT_ERROR(error.c_str());
+            return;
+        }
+        *cond = '\0';
+    }
+
     int b, c;
     switch (sscanf(input, "%d %d", &b, &c)) {
     case 1:
-        m_breakpoints[b] = 0;
+        bp.delay = 0;
         break;
     case 2:
         if (c <= 0) {
             PRINT_ERROR("# Error: Invalid breakpoint format");
-        } else {
-            m_breakpoints[b] = c;
+            return;
         }
+        bp.delay = c;
         break;
     default:
         PRINT_ERROR("# Error: Invalid breakpoint format");
+        return;
+    }
+
+    m_breakpoints[b] = std::move(bp);
+    if (b >= 0 && b % 4 == 0
+        && static_cast<size_t>(b / 4) < m_break_flags.size())
+        m_break_flags[b / 4] = true;
+}
+
+/*
+ * Called when the PC to be executed next is flagged in m_break_flags.
+ * The condition is evaluated first, and the delay is counted only when it
+ * holds.
+ */
+void Simulator::hitBreakpoint()
+{
+    auto bp = m_breakpoints.find(m_pc);
+    if (bp == m_breakpoints.end())
+        return;
+
+    auto& b = bp->second;
+    if (not b.cond.empty()) {
+        Condition::Context ctx{m_reg.data(), m_freg.data(),
+            m_memory, m_memory_num, m_cnt.dynamic_inst, m_pc};
+        if (not b.cond.eval(ctx))
+            return;
+    }
+
+    if (b.delay == 0)  // break
+        m_running = false;
+    else
+        b.delay--;
+}
+
+void Simulator::inputWatchpoint(char* input, bool store)
+{
+    size_t begin, len = 1;
+    switch (sscanf(input, "%zu %zu", &begin, &len)) {
+    case 1:
+    case 2:
+        break;
+    default:
+        PRINT_ERROR("# Error: Invalid watchpoint format");
+        return;
+    }
+
+    if (len == 0 || begin >= m_memory_num || len > m_memory_num - begin) {
+        PRINT_ERROR("# Error: Invalid watchpoint range");
+        return;
+    }
+
+    m_watchpoints.emplace_back(Watchpoint{begin, begin + len, store});
+
+    m_watch_pages.resize((m_memory_num >> WATCH_PAGE_SHIFT) + 1);
+    for (auto p = begin >> WATCH_PAGE_SHIFT;
+         p <= (begin + len - 1) >> WATCH_PAGE_SHIFT; p++)
+        m_watch_pages[p] = true;
+}
+
+void Simulator::deleteWatchpoint(size_t begin)
+{
+    std::vector<Watchpoint> remain;
+    for (const auto& w : m_watchpoints) {
+        if (w.begin != begin)
+            remain.emplace_back(w);
+    }
+    m_watchpoints.swap(remain);
+
+    m_watch_pages.clear();
+    if (m_watchpoints.empty())
+        return;
+
+    m_watch_pages.resize((m_memory_num >> WATCH_PAGE_SHIFT) + 1);
+    for (const auto& w : m_watchpoints) {
+        for (auto p = w.begin >> WATCH_PAGE_SHIFT;
+             p <= (w.end - 1) >> WATCH_PAGE_SHIFT; p++)
+            m_watch_pages[p] = true;
+    }
+}
+
+void Simulator::hitWatchpoint(size_t idx, bool store)
+{
+    for (const auto& w : m_watchpoints) {
+        if (w.store == store && w.begin <= idx && idx < w.end) {
+            m_running = false;
+
+            m_watch_hit.hit = true;
+            m_watch_hit.pc = m_pc;
+            m_watch_hit.idx = idx;
+            m_watch_hit.store = store;
+            m_watch_hit.preval = m_memory[idx];
+            return;
+        }
     }
 }
 
 void Simulator::reset()
 {
-    m_memory_idx_max = 0;
-    for (auto& m : m_memory_access_cnt)
-        m.second = 0;
+    m_cnt.clear();
+    if (m_reuse)
+        m_reuse.reset(new ReuseDistance{m_cnt.reuse_hist.size()});
+    if (m_prefetch)
+        m_prefetch.reset(new PrefetchEvaluator{m_prefetchers});
+    if (m_interval_len > 0)
+        beginIntervals();
+    if (m_sampler)
+        m_sampler->clear();
 
     m_start_time = std::chrono::high_resolution_clock::now();
 
     m_halt = false;
     m_running = false;
+    m_in_roi = false;
 
     for (auto& b : m_breakpoints)
-        b.second = 0;
-
-    m_dynamic_inst_cnt = 0;
-    for (auto& c : m_pc_called_cnt)
-        c = 0;
-    m_pc = 0;
+        b.second.delay = 0;
 
     for (auto& r : m_reg)
         r = 0;
@@ -299,24 +682,59 @@ void Simulator::reset()
         r = 0;
     for (size_t i = 0; i < m_memory_num; i++)
         m_memory[i] = 0;
-
-    for (auto& p : m_inst_cnt)
-        p.second = 0;
+    loadSegments();
 
     m_breakpoints.clear();
+    for (auto&& f : m_break_flags)
+        f = false;
+
+    m_watchpoints.clear();
+    m_watch_pages.clear();
+    m_watch_hit.hit = false;
+
+    for (auto& w : m_writers)
+        w = 0;
 
     m_state_hist.deque.clear();
     m_state_hist.push(PreState{});
     m_state_hist_iter = m_state_hist.deque.begin();
 
+    if (m_metrics)
+        publishMetrics();
     printConsole();
     refresh();
 }
 
+template <class P>
 Simulator::PreState Simulator::exec(OpCode opcode, Instruction inst)
 {
-    m_inst_cnt[opcode]++;
-    return execInst(opcode, inst);
+    if (P::count)
+        m_cnt.inst[opcode]++;
+    return execInst<P>(opcode, inst);
+}
+
+// Execute the codes at idx and idx + 1, calling their handlers directly
+template <class P>
+void Simulator::execFused(FusedOp op, size_t idx)
+{
+    if (P::count) {
+        m_cnt.inst[m_image->opcodes[idx]]++;
+        m_cnt.inst[m_image->opcodes[idx + 1]]++;
+    }
+
+    switch (op) {
+#define FUSED_PAIR_CASE(a, b, first, second) \
+    case FusedOp::a##_##b:                   \
+        first<P>(m_codes[idx]);              \
+        second<P>(m_codes[idx + 1]);         \
+        break;
+
+        FELIS_SIM_FOR_EACH_FUSED_PAIR(FUSED_PAIR_CASE)
+
+#undef FUSED_PAIR_CASE
+    default:
+        break;
+    }
 }
 
 void Simulator::printConsole()
@@ -327,30 +745,200 @@ void Simulator::printConsole()
     printCode();
 }
 
-void Simulator::dumpLog() const
+void Simulator::Counters::clear()
 {
-    using namespace std;
+    dynamic_inst = 0;
+    for (auto& c : pc_called)
+        c = 0;
+    for (auto& p : inst)
+        p.second = 0;
 
-    addstr("Outputting stat info... ");
-    refresh();
+    memory_idx_max = 0;
+    for (auto& m : memory_access)
+        m.second = 0;
+
+    for (auto& l : loops)
+        l = LoopCounter{};
+
+    for (auto& r : reuse_hist)
+        r = 0;
+    reuse_cold = 0;
+}
+
+void Simulator::Counters::merge(const Counters& other)
+{
+    dynamic_inst += other.dynamic_inst;
+    samples += other.samples;
+    if (pc_called.size() < other.pc_called.size())
+        pc_called.resize(other.pc_called.size());
+    for (size_t i = 0; i < other.pc_called.size(); i++)
+        pc_called[i] += other.pc_called[i];
+    for (const auto& p : other.inst)
+        inst[p.first] += p.second;
+
+    if (memory_idx_max < other.memory_idx_max)
+        memory_idx_max = other.memory_idx_max;
+    for (const auto& m : other.memory_access)
+        memory_access[m.first] += m.second;
+
+    if (loops.size() < other.loops.size())
+        loops.resize(other.loops.size());
+    for (size_t l = 0; l < other.loops.size(); l++) {
+        loops[l].entries += other.loops[l].entries;
+        loops[l].iterations += other.loops[l].iterations;
+        for (int b = 0; b < LoopCounter::TRIP_HIST_NUM; b++)
+            loops[l].trip_hist[b] += other.loops[l].trip_hist[b];
+    }
+
+    if (reuse_hist.size() < other.reuse_hist.size())
+        reuse_hist.resize(other.reuse_hist.size());
+    for (size_t d = 0; d < other.reuse_hist.size(); d++)
+        reuse_hist[d] += other.reuse_hist[d];
+    reuse_cold += other.reuse_cold;
+    simpoints += other.simpoints;
+}
+
+void Simulator::Counters::scale(double factor)
+{
+    auto scaled = [factor](int64_t c) {
+        return static_cast<int64_t>(static_cast<double>(c) * factor + 0.5);
+    };
+
+    for (auto& c : pc_called)
+        c = scaled(c);
+    for (auto& p : inst)
+        p.second = scaled(p.second);
+    for (auto& m : memory_access)
+        m.second = static_cast<uint32_t>(scaled(m.second));
+
+    for (auto& l : loops) {
+        l.entries = scaled(l.entries);
+        l.iterations = scaled(l.iterations);
+        for (auto& t : l.trip_hist)
+            t = scaled(t);
+    }
+
+    for (auto& r : reuse_hist)
+        r = scaled(r);
+    reuse_cold = scaled(reuse_cold);
+}
+
+void Simulator::dumpCounters(const Counters& cnt, bool output_memory)
+{
+    using namespace std;
 
     {
         ofstream ofs{"call_cnt.log"};
-        ofs << "# dynamic inst cnt = " << m_dynamic_inst_cnt << endl;
+        ofs << "# dynamic inst cnt = " << cnt.dynamic_inst << endl;
+        if (cnt.samples > 0)
+            ofs << "# estimated from " << cnt.samples << " PC samples" << endl;
+        if (cnt.simpoints > 0)
+            ofs << "# estimated from " << cnt.simpoints << " intervals" << endl;
         ofs << "# PC : called cnt" << endl;
-        for (size_t i = 0; i < m_pc_called_cnt.size(); i++)
-            ofs << 4 * i << ' ' << m_pc_called_cnt.at(i) << endl;
+        for (size_t i = 0; i < cnt.pc_called.size(); i++)
+            ofs << 4 * i << ' ' << cnt.pc_called.at(i) << '\n';
     }
 
     {
         ofstream ofs{"instruction.log"};
         ofs << "# inst number : called cnt" << endl;
-        for (auto inst : m_inst_cnt)
+        for (auto inst : cnt.inst)
             ofs << static_cast<uint32_t>(inst.first) << ' '
-                << inst.second << endl;
+                << inst.second << '\n';
     }
 
-    {
+    if (output_memory) {
+        ofstream ofs{"memory_access_cnt.log"};
+        for (std::pair<uint32_t, uint32_t> p : cnt.memory_access)
+            ofs << p.first << ' ' << p.second << '\n';
+    }
+}
+
+/*
+ * Only the distances accessed are written. The hit rate of a cache of n
+ * lines is that of the last line with a distance less than n.
+ */
+void Simulator::dumpReuse(const Counters& cnt, int line_words)
+{
+    using namespace std;
+
+    int64_t total = cnt.reuse_cold;
+    for (auto c : cnt.reuse_hist)
+        total += c;
+
+    ofstream ofs{"reuse.log"};
+    ofs << "# line = " << line_words << " words, accesses = " << total
+        << ", cold = " << cnt.reuse_cold << endl;
+    ofs << "# distance : accesses, hit rate of a fully associative LRU cache"
+           " of distance + 1 lines"
+        << endl;
+
+    int64_t hits = 0;
+    for (size_t d = 0; d < cnt.reuse_hist.size(); d++) {
+        auto c = cnt.reuse_hist[d];
+        if (c == 0)
+            continue;
+        hits += c;
+        char rate[32];
+        snprintf(rate, sizeof rate, "%.6f",
+            static_cast<double>(hits) / static_cast<double>(total));
+        ofs << d << ' ' << c << ' ' << rate << endl;
+    }
+}
+
+/*
+ * Counters estimated from the PC samples.
+ * Each sample stands for (dynamic inst cnt / total samples) instructions.
+ */
+Simulator::Counters Simulator::sampledCounters() const
+{
+    auto cnt = m_cnt;
+
+    const auto& samples = m_sampler->samples();
+    auto total = m_sampler->total();
+    double scale = total > 0
+                       ? static_cast<double>(cnt.dynamic_inst)
+                             / static_cast<double>(total)
+                       : 0;
+    cnt.samples = total;
+
+    for (size_t i = 0; i < cnt.pc_called.size(); i++) {
+        auto c = static_cast<int64_t>(
+            static_cast<double>(samples.at(i)) * scale + 0.5);
+        cnt.pc_called.at(i) = c;
+        if (c > 0)
+            cnt.inst[m_image->opcodes.at(i)] += c;
+    }
+
+    return cnt;
+}
+
+void Simulator::dumpLog() const
+{
+    HostProfiler::Scope scope{HostProfiler::STATS};
+    using namespace std;
+
+    if (g_ncurses) {
+        addstr("Outputting stat info... ");
+        refresh();
+    }
+
+    const auto& cnt = m_sampling ? sampledCounters() : m_cnt;
+    if (m_binary_stats)
+        dumpBinary(cnt, m_output_memory, this);
+    else
+        dumpCounters(cnt, m_output_memory);
+    if (m_loop_profile)
+        dumpLoops(cnt, *m_image);
+    if (m_reuse)
+        dumpReuse(cnt, static_cast<int>(m_reuse_line));
+    if (m_prefetch) {
+        ofstream ofs{"prefetch.log"};
+        m_prefetch->dump(ofs);
+    }
+
+    // The registers and the memory are in stats.bin if binary
+    if (not m_binary_stats) {
         ofstream ofs{"register.log"};
         ofs << hex;
         ofs << "# General purpose registers" << endl;
@@ -361,17 +949,16 @@ void Simulator::dumpLog() const
             ofs << "0x" << ftou(f) << endl;
     }
 
-    if (m_output_memory) {
+    if (m_output_memory && not m_binary_stats) {
         ofstream ofs{"memory.log"};
-        ofs << "# Max idx = " << m_memory_idx_max << endl;
+        ofs << "# Max idx = " << m_cnt.memory_idx_max << endl;
         ofs << hex;
         for (size_t i = 0; i < m_memory_num; i++)
-            ofs << m_memory[i] << endl;
-        ofstream ofs2{"memory_access_cnt.log"};
-        for (std::pair<uint32_t, uint32_t> p : m_memory_access_cnt)
-            ofs2 << p.first << ' ' << p.second << endl;
+            ofs << m_memory[i] << '\n';
     }
 
-    addstr("done!\n");
-    refresh();
+    if (g_ncurses) {
+        addstr("done!\n");
+        refresh();
+    }
 }
@@ -7,44 +7,266 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <memory>
 #include <string>
+#include "array_view.hpp"
 #include "sized_deque.hpp"
+#include "pc_sampler.hpp"
+#include "guarded_memory.hpp"
+#include "reuse_distance.hpp"
+#include "prefetcher.hpp"
+#include "metrics.hpp"
+#include "host_profiler.hpp"
+#include "condition.hpp"
 #include "opcode.hpp"
 
+/*
+ * Pairs of codes frequent in compiler output, executed as one operation in
+ * a headless run: m(first opcode, second opcode, first handler, second handler)
+ */
+#define FELIS_SIM_FOR_EACH_FUSED_PAIR(m) \
+    m(LUI, ORI, lui, ori)                \
+    m(ADDI, ADDI, addi, addi)            \
+    m(ADDI, BEQ, addi, beq)              \
+    m(ADDI, BGEZ, addi, bgez)            \
+    m(ADDI, BGTZ, addi, bgtz)            \
+    m(ADDI, BLEZ, addi, blez)            \
+    m(ADDI, BLTZ, addi, bltz)            \
+    m(LW, ADD, lw, add)                  \
+    m(LW, ADDI, lw, addi)                \
+    m(MTC1, CVT_S_W, mtc1, cvt_s_w)
+
 class Simulator
 {
 public:
+    using Instruction = uint32_t;  // 32bit Instruction code
+
+#define FELIS_SIM_FUSED_OP(a, b, first, second) a##_##b,
+    enum class FusedOp : uint8_t {
+        NONE,
+        FELIS_SIM_FOR_EACH_FUSED_PAIR(FELIS_SIM_FUSED_OP)
+        // Not pairs: ROI markers, only in the table of a Simulator
+        ROI_BEGIN,
+        ROI_END,
+    };
+#undef FELIS_SIM_FUSED_OP
+
+    /*
+     * Loaded and decoded program.
+     * Immutable after loading, so that simulators running on several threads
+     * can share one image.
+     */
+    struct ProgramImage {
+        std::string binfile_name;
+        std::vector<Instruction> codes;
+        uint32_t entry = 0;  // PC to start from
+
+        // Initialized data of a sectioned image (image.cpp), in 'mapping'
+        struct Segment {
+            uint32_t addr;  // word index in the memory
+            const int32_t* words;
+            uint32_t num;
+        };
+        std::vector<Segment> data;
+        std::shared_ptr<const void> mapping;
+        std::unordered_map<uint32_t, std::string> symbols;  // by value
+
+        /*
+         * Analysis of the codes, in 'analysis': the Analysis made by
+         * loadImage(), or the mapping of a cache file (image_cache.cpp)
+         */
+        ArrayView<OpCode> opcodes;     // decoded opcode of each code
+        ArrayView<uint8_t> pc_check;   // the PC may leave the image after the code
+        ArrayView<FusedOp> fused;      // pair starting at each code, or NONE
+        ArrayView<uint8_t> block_end;  // control may not fall through the code
+
+        /*
+         * Natural loops found from backward branches and jumps, each as the
+         * range [header, latch] of code indices. A loop with several back
+         * edges to one header spans up to the last of them.
+         */
+        struct Loop {
+            uint32_t header, latch;
+            int32_t parent;  // smallest enclosing loop, or -1
+        };
+        ArrayView<Loop> loops;       // sorted by header
+        ArrayView<int32_t> loop_of;  // innermost loop of each code, or -1
+
+        // Disassembly of each code, NUL-terminated and concatenated
+        ArrayView<char> asm_text;
+        ArrayView<uint32_t> asm_offset;
+
+        std::shared_ptr<const void> analysis;
+
+        struct Analysis {
+            std::vector<OpCode> opcodes;
+            std::vector<uint8_t> pc_check;
+            std::vector<FusedOp> fused;
+            std::vector<uint8_t> block_end;
+            std::vector<Loop> loops;
+            std::vector<int32_t> loop_of;
+            std::vector<char> asm_text;
+            std::vector<uint32_t> asm_offset;
+        };
+        void setAnalysis(std::shared_ptr<const Analysis> a)
+        {
+            opcodes = a->opcodes;
+            pc_check = a->pc_check;
+            fused = a->fused;
+            block_end = a->block_end;
+            loops = a->loops;
+            loop_of = a->loop_of;
+            asm_text = a->asm_text;
+            asm_offset = a->asm_offset;
+            analysis = std::move(a);
+        }
+
+        const char* disasm(size_t idx) const
+        {
+            return asm_text.data() + asm_offset[idx];
+        }
+    };
+
+    // With 'cache_dir', the analysis is reused across runs (image_cache.cpp)
+    static std::shared_ptr<const ProgramImage> loadImage(
+        const std::string& binfile, const std::string& cache_dir = "");
+    // Read the codes, or the sections of a sectioned image
+    static void readImage(ProgramImage& image, const std::string& binfile);
+    static bool loadCachedImage(ProgramImage& image, const std::string& dir);
+    static bool checkCachedImage(const ProgramImage& image);
+    static void saveCachedImage(
+        const ProgramImage& image, const std::string& dir);
+
+    struct Config {
+        std::string infile;
+        std::string outfile = "out.log";
+        size_t memory_num = 1000000;
+        bool interactive = true;
+        bool output_memory = false;
+        bool prev_disable = false;
+        bool quit_run = false;
+#ifdef FELIS_SIM_NO_ASSERT
+        bool checked = false;  // check PC and memory index ranges
+#else
+        bool checked = true;  // check PC and memory index ranges
+#endif
+        int sample_hz = 0;  // > 0: sample PCs instead of counting them
+        int writer_depth = 0;  // > 0: record the last writers of each word
+        // Provisional FPU model instead of host floats. Not selectable from
+        // the command line until the model follows the FELIS FPU.
+        bool hw_fpu = false;
+        bool fuse = true;      // execute fused pairs in headless runs
+        bool loop_profile = false;  // count loop iterations (loop.log)
+        int reuse_line = 0;  // > 0: reuse distances of lines of this many words
+        std::string prefetchers;  // comma-separated prefetchers to evaluate
+        int64_t interval = 0;  // > 0: statistics of each interval of this many instructions
+        bool bbv = false;      // basic block vectors of the intervals (bbv.txt)
+        std::string simpoints;  // intervals to run in detail, from tools/simpoint.py
+        std::string roi;  // "nop" or "<begin>:<end>" PCs: profile only in the ROI
+        bool binary_stats = false;  // stats.bin instead of the text logs
+        std::string metrics;  // shared memory name for live metrics
+    };
+
+    /*
+     * Statistics of a run.
+     * Counters of simulators sharing the same image can be merged.
+     */
+    struct Counters {
+        int64_t dynamic_inst = 0;
+        std::vector<int64_t> pc_called;             // PCごとの実行回数
+        std::unordered_map<OpCode, int64_t> inst;  // 命令ごとの実行回数
+        int64_t samples = 0;  // > 0: pc_called and inst are estimated from PC samples
+        int64_t simpoints = 0;  // > 0: estimated from this many intervals
+
+        size_t memory_idx_max = 0;
+        std::unordered_map<size_t, uint32_t> memory_access;
+
+        // Statistics of each loop of ProgramImage::loops
+        struct LoopCounter {
+            int64_t entries = 0;
+            int64_t iterations = 0;  // trip counts of the closed entries
+            int64_t trip = 0;        // back edges taken since the entry
+            static constexpr int TRIP_HIST_NUM = 64;
+            // entries by floor(log2(trip count)), where trip count = trip + 1
+            std::array<int64_t, TRIP_HIST_NUM> trip_hist = {{}};
+        };
+        std::vector<LoopCounter> loops;  // empty unless profiling loops
+
+        // Accesses by reuse distance in lines, empty unless profiling reuse
+        std::vector<int64_t> reuse_hist;
+        int64_t reuse_cold = 0;
+
+        void clear();
+        void merge(const Counters&);
+        void scale(double);  // all but dynamic_inst and the maxima
+    };
+
     explicit Simulator(
-        const std::string& binfile,
-        const std::string& infile,
-        const std::string& outfile,
-        size_t memory_num,
-        bool interactive,
-        bool output_memory,
-        bool prev_disable,
-        bool quit_run);
+        std::shared_ptr<const ProgramImage> image, const Config& config);
 
     void run();
+    void runHeadless();  // run to HALT without ncurses
     void disasm();
 
-    ~Simulator();
+    void dumpLog() const;
+    static void dumpCounters(const Counters&, bool output_memory);
+    // stats.bin, with the registers and the memory of 'state' if given
+    static void dumpBinary(
+        const Counters&, bool output_memory, const Simulator* state);
+    static void dumpLoops(const Counters&, const ProgramImage&);
+    static void dumpReuse(const Counters&, int line_words);
+    const Counters& counters() const { return m_cnt; }
+
+    /*
+     * Run the image for each of infiles on thread_num threads, and dump the
+     * merged counters.
+     * OUT of the k-th input is written to '<config.outfile>.<k>'.
+     * An input failing is reported after all the threads end, and the
+     * counters are merged from the rest. False if any input failed.
+     */
+    static bool sweep(
+        std::shared_ptr<const ProgramImage> image,
+        const Config& config,
+        const std::vector<std::string>& infiles,
+        int thread_num);
 
 private:
-    const std::string m_binfile_name;
-    std::ifstream m_binfile;
+    const std::shared_ptr<const ProgramImage> m_image;
+    const std::vector<Instruction>& m_codes;
+
     const std::string m_infile_name;
     std::ifstream m_infile;
     std::ofstream m_outfile;
 
     const size_t m_memory_num;
-    size_t m_memory_idx_max = 0;
-
-    std::unordered_map<size_t, uint32_t> m_memory_access_cnt;
 
     const bool m_interactive;
+    const bool m_checked;
     const bool m_output_memory;
     const bool m_prev_disable;
     const bool m_quit_run;
+    const bool m_sampling;
+    const bool m_hw_fpu;
+    const bool m_loop_profile;
+    const int64_t m_interval_len;
+    const bool m_collect_bbv;
+    const bool m_binary_stats;
+
+    // ProgramImage::fused, or all NONE if fusion is disabled
+    const FusedOp* m_fused;
+    std::vector<FusedOp> m_unfused;
+
+    /*
+     * Region of interest of a headless run.
+     * The profilers run only from a ROI_BEGIN code up to an ROI_END code,
+     * and the rest runs with only the checks. The markers are put in a copy
+     * of m_fused, so that a run without them pays nothing.
+     */
+    static constexpr Instruction ROI_BEGIN_NOP = 0x10000001;
+    static constexpr Instruction ROI_END_NOP = 0x10000002;
+    std::vector<FusedOp> m_marked;
+    bool m_in_roi = false;
+    void markRoi(const std::string& spec);
 
     const int64_t m_refresh_inst_cnt;
 
@@ -53,16 +275,138 @@ private:
     bool m_halt = false;
     bool m_running = false;
 
-    // breakpointの、PCとdelay（N回通ったらbreak）のマップ
-    std::unordered_map<int64_t, int64_t> m_breakpoints;
+    // breakpointの、PCとdelay（N回通ったらbreak）と条件のマップ
+    struct Breakpoint {
+        int64_t delay;
+        Condition cond;  // empty: always
+    };
+    std::unordered_map<int64_t, Breakpoint> m_breakpoints;
+    std::vector<bool> m_break_flags;  // breakpointが張られているPC/4
     void inputBreakpoint(char* input);
+    void hitBreakpoint();
 
-    // Instruction
-    using Instruction = uint32_t;  // 32bit Instruction code
-    std::vector<Instruction> m_codes;
+    /*
+     * Execution policy.
+     * The execution core (the loop, exec() and the instruction handlers) is
+     * instantiated for every combination of these flags, and the one matching
+     * the configuration is chosen at runtime, so that disabled features cost
+     * nothing in the loop.
+     */
+    enum ExecFlag : unsigned {
+        EXEC_CHECKED = 1,      // check PC and memory index ranges
+        EXEC_HISTORY = 2,      // save PreState for prev
+        EXEC_MEM_PROFILE = 4,  // count memory accesses (-m, -R, -P, -I)
+        EXEC_COUNT = 8,        // count PCs and instructions (not sampling)
+        EXEC_HW_FPU = 16,      // provisional FPU model (fpu.hpp)
+        EXEC_PROFILE = 32,     // call profileBlockEnd() at the end of blocks
+    };
+    static constexpr unsigned EXEC_POLICY_NUM = 64;
+
+    template <unsigned Flags>
+    struct ExecPolicy {
+        static constexpr bool checked = (Flags & EXEC_CHECKED) != 0;
+        static constexpr bool history = (Flags & EXEC_HISTORY) != 0;
+        static constexpr bool mem_profile = (Flags & EXEC_MEM_PROFILE) != 0;
+        static constexpr bool count = (Flags & EXEC_COUNT) != 0;
+        static constexpr bool hw_fpu = (Flags & EXEC_HW_FPU) != 0;
+        static constexpr bool profile = (Flags & EXEC_PROFILE) != 0;
+    };
+
+    unsigned execFlags() const;
+
+    void runInteractive(int64_t step_num);
+    int64_t execute(int64_t n);  // dispatch to the policy of execFlags()
+    template <class P>
+    int64_t execute(int64_t n);
+    // Run until HALT, or until 'limit' instructions have run in total
+    template <class P>
+    void runToHalt(int64_t limit);
+    using RunToHalt = void (Simulator::*)(int64_t);
+    // 'run' in GuardedMemory::run()
+    void runTo(RunToHalt run, int64_t limit);
+    // runToHalt() counting each handler in m_host, without fused pairs
+    template <class P>
+    void runToHaltHost(int64_t limit);
+    HostProfiler* m_host = nullptr;
+    void beginHostHandlers();
+
+    /*
+     * SimPoint sampled run: fast-forward to each chosen interval with only
+     * the checks, and run the interval itself with all the profilers.
+     * The counters of each interval are scaled by its weight times the
+     * number of intervals, as estimates of the whole run.
+     */
+    struct SimPoint {
+        int64_t interval;
+        double weight;
+    };
+    std::vector<SimPoint> m_simpoints;
+    int64_t m_simpoint_len = 0;
+    void loadSimPoints(const std::string& file);
+    void runSimPoints(const RunToHalt table[]);
+    void runRoi(const RunToHalt table[]);
+
+    // Live metrics, published every METRICS_INSTS instructions at most
+    static constexpr int64_t METRICS_INSTS = 1 << 24;
+    std::unique_ptr<MetricsPublisher> m_metrics;
+    void openMetrics(const std::string& name);
+    void publishMetrics();
+    // The limit of a headless run until the next publication
+    int64_t metricsLimit() const
+    {
+        return m_metrics ? m_cnt.dynamic_inst + METRICS_INSTS : INT64_MAX;
+    }
+    // Run to HALT or an ROI marker, publishing the metrics on the way
+    void runChunks(RunToHalt);
+
+    // The PC is checked only after the codes flagged in ProgramImage::pc_check
+    void checkPC() const;
+    void loadSegments();
+
+    /*
+     * Profilers hooked at the end of each basic block, i.e. after the codes
+     * flagged in ProgramImage::block_end, with the next PC in m_pc.
+     */
+    void profileBlockEnd(size_t idx);
+    void closeLoop(Counters::LoopCounter&);
+    // Loops containing the code idx, in m_loops_at from
+    // m_loops_at_begin[idx] to m_loops_at_begin[idx + 1]
+    std::vector<uint32_t> m_loops_at_begin;
+    std::vector<uint32_t> m_loops_at;
+    void indexLoops();
 
-    int64_t m_dynamic_inst_cnt = 0;
-    std::vector<int64_t> m_pc_called_cnt;  // PCごとの実行回数
+    /*
+     * Statistics of each interval of m_interval_len instructions, streamed
+     * to interval.csv. The k-th interval ends at the first block end after
+     * k * m_interval_len instructions, right before the code ending the
+     * block. The instruction mix is added up for each run of codes between
+     * block ends, from the kinds counted in m_kinds_before.
+     */
+    static constexpr uint32_t INTERVAL_PAGE_WORDS = 1024;
+    struct Interval {
+        int64_t start = 0;    // dynamic instruction count at the start
+        uint32_t number = 1;  // from 1, also the stamp in m_page_stamp
+        int64_t pages = 0;    // distinct pages of INTERVAL_PAGE_WORDS accessed
+        int64_t taken = 0;    // conditional branches taken
+    };
+    Interval m_interval;
+    std::vector<int64_t> m_interval_mix;  // instructions of each kind
+    std::vector<uint32_t> m_kinds_before;  // of each kind before each code
+    size_t m_run_begin = 0;                // code after the last block end
+    std::vector<uint32_t> m_page_stamp;    // last interval accessing each page
+    std::ofstream m_interval_file;
+    std::ofstream m_bbv_file;         // open if collecting BBVs
+    std::vector<uint32_t> m_block_of;  // block ID of each code, from 1
+    std::vector<int64_t> m_bbv;        // instructions of each block
+    std::vector<uint32_t> m_bbv_touched;  // blocks run in the interval
+    void beginIntervals();
+    void addIntervalRun(size_t begin, size_t end);
+    void profileInterval(size_t idx);
+    void flushInterval();
+
+    Counters m_cnt;
+    std::unique_ptr<PCSampler> m_sampler;
+    Counters sampledCounters() const;
 
     // State
     uint32_t m_pc = 0;
@@ -78,9 +422,107 @@ private:
     static constexpr int FREG_NUM = 32;
     std::array<float, FREG_NUM> m_freg = {{}};
 
-    // Memory
+    /*
+     * Memory.
+     * Indexed with uint32_t, so that out-of-range accesses fault on the guard
+     * region after the words instead of being compared on each access.
+     */
     int32_t* m_memory;
-    void checkMemoryIndex(size_t idx);
+    std::unique_ptr<GuardedMemory> m_guarded_memory;
+
+    template <class P>
+    void checkMemoryIndex(uint32_t idx, bool store)
+    {
+        if (P::mem_profile) {
+            if (m_output_memory) {
+                if (m_cnt.memory_idx_max < idx)
+                    m_cnt.memory_idx_max = idx;
+
+                m_cnt.memory_access[idx]++;
+            }
+
+            // An out-of-range access faults right after this
+            if (m_reuse && idx < m_memory_num) {
+                auto d = m_reuse->access(idx / m_reuse_line);
+                if (d == ReuseDistance::COLD)
+                    m_cnt.reuse_cold++;
+                else
+                    m_cnt.reuse_hist[static_cast<size_t>(d)]++;
+            }
+
+            if (m_prefetch && idx < m_memory_num)
+                m_prefetch->access(m_pc, idx, store, m_cnt.dynamic_inst);
+
+            if (m_interval_len > 0 && idx < m_memory_num) {
+                auto& stamp = m_page_stamp[idx / INTERVAL_PAGE_WORDS];
+                if (stamp != m_interval.number) {
+                    stamp = m_interval.number;
+                    m_interval.pages++;
+                }
+            }
+        }
+    }
+
+    // LRU stack distances of the accesses, in lines of m_reuse_line words
+    const size_t m_reuse_line;
+    std::unique_ptr<ReuseDistance> m_reuse;
+
+    const std::string m_prefetchers;
+    std::unique_ptr<PrefetchEvaluator> m_prefetch;
+
+    /*
+     * Watchpoint.
+     * Words of [begin, end) are watched. Accesses are checked against the
+     * watchpoints only when the page containing the word is flagged.
+     */
+    struct Watchpoint {
+        size_t begin, end;
+        bool store;  // true: write watch, false: read watch
+    };
+    std::vector<Watchpoint> m_watchpoints;
+    static constexpr int WATCH_PAGE_SHIFT = 10;  // 1024 words per page
+    std::vector<bool> m_watch_pages;             // empty if no watchpoint
+
+    struct WatchHit {
+        bool hit = false;
+        uint32_t pc;
+        size_t idx;
+        bool store;
+        int32_t preval;
+    } m_watch_hit;
+
+    void watchMemory(size_t idx, bool store)
+    {
+        auto page = idx >> WATCH_PAGE_SHIFT;
+        if (page < m_watch_pages.size() && m_watch_pages[page])
+            hitWatchpoint(idx, store);
+    }
+    void hitWatchpoint(size_t idx, bool store);
+    void inputWatchpoint(char* input, bool store);
+    void deleteWatchpoint(size_t begin);
+
+    /*
+     * Shadow memory of the last writers.
+     * For each word, the m_writer_depth latest stores are kept newest first,
+     * each packed in 64 bit as (PC / 4 + 1) << 40 | dynamic inst cnt.
+     * 0 means not written.
+     */
+    const size_t m_writer_depth;
+    std::vector<uint64_t> m_writers;  // empty if not recording
+    static constexpr int WRITER_CNT_BITS = 40;
+
+    void recordWriter(size_t idx)
+    {
+        if (m_writers.empty())
+            return;
+
+        auto w = m_writers.data() + idx * m_writer_depth;
+        for (auto d = m_writer_depth - 1; d > 0; d--)
+            w[d] = w[d - 1];
+        w[0] = (static_cast<uint64_t>(m_pc / 4 + 1) << WRITER_CNT_BITS)
+               | (static_cast<uint64_t>(m_cnt.dynamic_inst)
+                     & ((1ull << WRITER_CNT_BITS) - 1));
+    }
 
     // State history
     struct PreState {
@@ -108,43 +550,57 @@ private:
         } mem;
     };
 
+    // Nothing is saved unless P::history
+    template <class P>
     PreState makePrePCState(uint32_t pc) const
     {
         PreState pre_state;
+        if (not P::history)
+            return pre_state;
+
         pre_state.pc.changed = true;
         pre_state.pc.preval = pc;
         return pre_state;
     }
 
+    template <class P>
     PreState makePreGPRegState(size_t idx) const
     {
         PreState pre_state;
+        if (not P::history)
+            return pre_state;
 
         pre_state.pc.changed = true;
         pre_state.pc.preval = m_pc;
 
         pre_state.gpreg.changed = true;
         pre_state.gpreg.idx = idx;
-        pre_state.gpreg.preval = m_reg.at(idx);
+        pre_state.gpreg.preval = m_reg[idx];
         return pre_state;
     }
 
+    template <class P>
     PreState makePreFRegState(size_t idx) const
     {
         PreState pre_state;
+        if (not P::history)
+            return pre_state;
 
         pre_state.pc.changed = true;
         pre_state.pc.preval = m_pc;
 
         pre_state.freg.changed = true;
         pre_state.freg.idx = idx;
-        pre_state.freg.preval = m_freg.at(idx);
+        pre_state.freg.preval = m_freg[idx];
         return pre_state;
     }
 
+    template <class P>
     PreState makeMemPreState(size_t idx) const
     {
         PreState pre_state;
+        if (not P::history)
+            return pre_state;
 
         pre_state.pc.changed = true;
         pre_state.pc.preval = m_pc;
@@ -211,12 +667,27 @@ private:
         uint32_t addr;
     };
 
-    // Instruction called counter
-    std::unordered_map<OpCode, int64_t> m_inst_cnt;
-
     static OpCode decodeOpCode(Instruction);
 
+    static std::vector<uint8_t> verify(const std::vector<Instruction>& codes,
+        const std::vector<OpCode>& opcodes);
+
+    /*
+     * Find the pairs of FELIS_SIM_FOR_EACH_FUSED_PAIR.
+     * Only the first code is flagged, and a jump to the second one executes
+     * it alone. The first code of every pair falls through to the second.
+     */
+    static std::vector<FusedOp> fuse(const std::vector<OpCode>& opcodes);
+
+    // Set block_end, loops and loop_of of the analysis
+    static void findLoops(
+        const std::vector<Instruction>& codes, ProgramImage::Analysis&);
+
+    template <class P>
     PreState exec(OpCode, Instruction);
+    template <class P>
+    void execFused(FusedOp, size_t idx);
+    template <class P>
     PreState execInst(OpCode, Instruction);
 
     static OperandR decodeR(Instruction);
@@ -225,19 +696,20 @@ private:
 
     // disasm
     struct Mnemonic {
-        std::string mnemonic;
+        const char* mnemonic;
         OperandType type;
         // clang-format off
         enum class OperandField { N, R, I, F, };  // clang-format on
         std::array<OperandField, 4> operand_field;
     };
 
-    std::unordered_map<OpCode, Mnemonic> m_mnemonic_table;
-    void initDisassembler();
-
-    std::string disasm(Instruction) const;
+    using MnemonicTable = std::unordered_map<OpCode, Mnemonic>;
+    static MnemonicTable makeMnemonicTable();
+    static const MnemonicTable& mnemonicTable();
 
-    void dumpLog() const;
+    // Writes NUL-terminated disassembly into 'buf' and returns its length
+    static constexpr size_t DISASM_LEN_MAX = 64;
+    static int disasm(Instruction, char* buf, size_t size);
 
 
     // print
@@ -258,9 +730,43 @@ private:
     void printState() const;
     void printCode() const;
     void printBreakPoints() const;
+    void printWatchPoints() const;
+    void printWatchHit() const;
     void printMemory(size_t idx) const;
 
     void printHelp() const;
 
 #include "instructions.hpp"
 };
+
+/*
+ * Apply m(a, b, flags) to the flags of every execution policy.
+ */
+#define FELIS_SIM_FOR_EACH_EXEC_POLICY(m, a, b)                             \
+    m(a, b, 0) m(a, b, 1) m(a, b, 2) m(a, b, 3) m(a, b, 4) m(a, b, 5)       \
+    m(a, b, 6) m(a, b, 7) m(a, b, 8) m(a, b, 9) m(a, b, 10) m(a, b, 11)     \
+    m(a, b, 12) m(a, b, 13) m(a, b, 14) m(a, b, 15) m(a, b, 16) m(a, b, 17) \
+    m(a, b, 18) m(a, b, 19) m(a, b, 20) m(a, b, 21) m(a, b, 22) m(a, b, 23) \
+    m(a, b, 24) m(a, b, 25) m(a, b, 26) m(a, b, 27) m(a, b, 28) m(a, b, 29) \
+    m(a, b, 30) m(a, b, 31) m(a, b, 32) m(a, b, 33) m(a, b, 34) m(a, b, 35) \
+    m(a, b, 36) m(a, b, 37) m(a, b, 38) m(a, b, 39) m(a, b, 40) m(a, b, 41) \
+    m(a, b, 42) m(a, b, 43) m(a, b, 44) m(a, b, 45) m(a, b, 46) m(a, b, 47) \
+    m(a, b, 48) m(a, b, 49) m(a, b, 50) m(a, b, 51) m(a, b, 52) m(a, b, 53) \
+    m(a, b, 54) m(a, b, 55) m(a, b, 56) m(a, b, 57) m(a, b, 58) m(a, b, 59) \
+    m(a, b, 60) m(a, b, 61) m(a, b, 62) m(a, b, 63)
+
+/*
+ * Explicitly instantiate a member of the execution core returning PreState
+ * for every execution policy.
+ * FELIS_SIM_INSTANTIATE_EXEC(add, (Instruction))
+ */
+#define FELIS_SIM_INSTANTIATE_EXEC_FLAGS(name, params, flags) \
+    template Simulator::PreState                              \
+        Simulator::name<Simulator::ExecPolicy<flags>> params;
+
+#define FELIS_SIM_INSTANTIATE_EXEC(name, params) \
+    FELIS_SIM_FOR_EACH_EXEC_POLICY(              \
+        FELIS_SIM_INSTANTIATE_EXEC_FLAGS, name, params)
+
+#define FELIS_SIM_INSTANTIATE_INST(name) \
+    FELIS_SIM_INSTANTIATE_EXEC(name, (Instruction))
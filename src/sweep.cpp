@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "util.hpp"
+#include "simulator.hpp"
+
+bool Simulator::sweep(
+    std::shared_ptr<const ProgramImage> image,
+    const Config& config,
+    const std::vector<std::string>& infiles,
+    int thread_num)
+{
+    if (thread_num <= 0)
+        thread_num = std::max(1u, std::thread::hardware_concurrency());
+    thread_num = std::min(thread_num, static_cast<int>(infiles.size()));
+
+    std::atomic<size_t> next_input{0};
+    std::mutex merged_mutex;
+    Counters merged;
+    merged.pc_called.resize(image->codes.size());
+    if (config.loop_profile)
+        merged.loops.resize(image->loops.size());
+
+    // Message of each input failed, written only by the thread running it
+    std::vector<std::string> errors(infiles.size());
+
+    auto worker = [&]() {
+        Counters cnt;
+        cnt.pc_called.resize(image->codes.size());
+
+        while (true) {
+            auto k = next_input++;
+            if (k >= infiles.size())
+                break;
+
+            auto c = config;
+            c.infile = infiles[k];
+            c.outfile = config.outfile + '.' + std::to_string(k);
+            c.interactive = false;
+
+            try {
+                Simulator sim{image, c};
+                sim.runHeadless();
+                cnt.merge(sim.counters());
+            } catch (const std::exception& e) {
+                errors[k] = e.what();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{merged_mutex};
+        merged.merge(cnt);
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; t++)
+        threads.emplace_back(worker);
+    for (auto& t : threads)
+        t.join();
+
+    size_t failed = 0;
+    for (size_t k = 0; k < infiles.size(); k++) {
+        if (errors[k].empty())
+            continue;
+        std::cerr << "# Input " << k << " (" << infiles[k] << ") failed\n"
+                  << errors[k] << std::endl;
+        failed++;
+    }
+
+    if (config.binary_stats)
+        dumpBinary(merged, config.output_memory, nullptr);
+    else
+        dumpCounters(merged, config.output_memory);
+    if (config.loop_profile)
+        dumpLoops(merged, *image);
+    if (config.reuse_line > 0)
+        dumpReuse(merged, config.reuse_line);
+
+    if (failed > 0)
+        std::cerr << "# Error: " << failed << " of " << infiles.size()
+                  << " inputs failed" << std::endl;
+    return failed == 0;
+}
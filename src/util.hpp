@@ -2,16 +2,27 @@
 
 #include <cstdint>
 #include <cstring>
+#include <sstream>
+#include <stdexcept>
 #include <ncurses.h>
 
 extern bool g_ncurses;
 
-#define FAIL(msg)                      \
-    do {                               \
-        if (g_ncurses)                 \
-            endwin();                  \
-        std::cerr << msg << std::endl; \
-        std::exit(1);                  \
+/*
+ * Error thrown by FAIL with the message, reported by main() at exit, or by
+ * the thread running into it.
+ */
+class Failure : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+#define FAIL(msg)                         \
+    do {                                  \
+        std::ostringstream fail_oss_;     \
+        fail_oss_ << msg;                 \
+        throw Failure{fail_oss_.str()};   \
     } while (0)
 
 /*
@@ -70,3 +81,10 @@ inline uint32_t ftou(float f)
     FloatUBit fu{f};
     return fu.u;
 }
+
+inline float utof(uint32_t u)
+{
+    FloatUBit fu;
+    fu.u = u;
+    return fu.f;
+}
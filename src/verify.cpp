@@ -0,0 +1,63 @@
+#include "util.hpp"
+#include "simulator.hpp"
+
+/*
+ * Flag the codes after which the PC may leave the image.
+ * Direct branch and jump targets and fall-through paths are checked here
+ * once, so that the PC has to be checked at runtime only after the flagged
+ * codes: JR, JALR, and the codes whose successors are out of range.
+ */
+std::vector<uint8_t> Simulator::verify(
+    const std::vector<Instruction>& codes, const std::vector<OpCode>& opcodes)
+{
+    auto code_num = static_cast<int64_t>(codes.size());
+    auto inRange = [code_num](int64_t idx) {
+        return 0 <= idx && idx < code_num;
+    };
+
+    std::vector<uint8_t> pc_check(codes.size());
+    for (int64_t idx = 0; idx < code_num; idx++) {
+        auto inst = codes[idx];
+        bool safe;
+
+        switch (opcodes[idx]) {
+        case OpCode::HALT:
+            safe = true;
+            break;
+        case OpCode::ASRT:
+        case OpCode::ASRT_S:
+            safe = inRange(idx + 2);
+            break;
+        case OpCode::BEQ:
+        case OpCode::BGEZ:
+        case OpCode::BGTZ:
+        case OpCode::BLEZ:
+        case OpCode::BLTZ:
+        case OpCode::BGEZAL:
+        case OpCode::BLTZAL: {
+            auto offset = static_cast<int32_t>(
+                signExt(decodeI(inst).immediate, 16));
+            safe = inRange(idx + offset) && inRange(idx + 1);
+            break;
+        }
+        case OpCode::J:
+        case OpCode::JAL: {
+            auto pc = static_cast<uint32_t>(idx * 4);
+            auto target = (pc & 0xf0000003) | (decodeJ(inst).addr << 2);
+            safe = inRange(target / 4);
+            break;
+        }
+        case OpCode::JR:
+        case OpCode::JALR:
+            safe = false;
+            break;
+        default:
+            safe = inRange(idx + 1);
+            break;
+        }
+
+        pc_check[idx] = not safe;
+    }
+
+    return pc_check;
+}
@@ -0,0 +1,65 @@
+#include <iostream>
+#include "condition.hpp"
+
+using namespace std;
+
+#define myassert(b)                                        \
+    if (not(b)) {                                          \
+        cerr << "Assertion failed @ " << __LINE__ << endl; \
+        return 1;                                          \
+    }
+
+int main()
+{
+    int32_t reg[32] = {};
+    float freg[32] = {};
+    int32_t memory[16] = {};
+    Condition::Context ctx{reg, freg, memory, 16, 100, 1234};
+
+    auto check = [&ctx](const char* src) {
+        Condition cond;
+        std::string error;
+        if (not Condition::compile(src, cond, error)) {
+            cerr << src << ": " << error << endl;
+            return false;
+        }
+        return cond.eval(ctx);
+    };
+    auto invalid = [](const char* src) {
+        Condition cond;
+        std::string error;
+        return not Condition::compile(src, cond, error);
+    };
+
+    reg[5] = 0;
+    freg[3] = 1.5f;
+    memory[4] = -7;
+    memory[5] = 0x3fc00000;  // 1.5f
+
+    myassert(check("r5 == 0"));
+    myassert(not check("r5 != 0"));
+    myassert(check("r5 == 0 && f3 > 1.0"));
+    myassert(not check("r5 == 0 && f3 > 2"));
+    myassert(check("r5 == 1 || f3 >= 1.5"));
+    myassert(check("mem[4] == -7"));
+    myassert(check("mem[2 + 2] < 0"));
+    myassert(check("fmem[5] == f3"));
+    myassert(check("!(mem[4] > 0)"));
+    myassert(check("cnt >= 100 && pc == 1234"));
+    myassert(check("(r5 + 3) * 2 == 6"));
+    myassert(check("-mem[4] == 7"));
+    myassert(check("0x10 == 16"));
+    myassert(not check("mem[100] == 0"));  // out of range
+    myassert(not check("mem[100] != 0"));
+    myassert(check("1"));
+
+    myassert(invalid(""));
+    myassert(invalid("r32 == 0"));
+    myassert(invalid("r5 =="));
+    myassert(invalid("mem[4 == 0"));
+    myassert(invalid("r5 == 0 foo"));
+
+    cerr << "All test passed" << endl;
+
+    return 0;
+}
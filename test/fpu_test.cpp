@@ -0,0 +1,115 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "fpu.hpp"
+
+using namespace std;
+
+#define myassert(b)                                        \
+    if (not(b)) {                                          \
+        cerr << "Assertion failed @ " << __LINE__ << endl; \
+        return 1;                                          \
+    }
+
+static uint32_t bits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof u);
+    return u;
+}
+
+static float value(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof f);
+    return f;
+}
+
+// Error of 'actual' in units in the last place of 'expected'
+static double ulps(uint32_t actual, double expected)
+{
+    return fabs(value(actual) - expected) / ldexp(1.0, ilogb(expected) - 23);
+}
+
+int main()
+{
+    myassert(fpu::fadd(bits(1.5f), bits(2.25f)) == bits(3.75f));
+    myassert(fpu::fsub(bits(1.5f), bits(2.25f)) == bits(-0.75f));
+    myassert(fpu::fmul(bits(1.5f), bits(-2.0f)) == bits(-3.0f));
+    myassert(fpu::fsqrt(bits(4.0f)) == bits(2.0f));
+    myassert(fpu::fsqrt(bits(0.25f)) == bits(0.5f));
+
+    // denormals are zero
+    myassert(fpu::fadd(0x00000001, 0x00000001) == 0);
+    myassert(fpu::fmul(bits(1e-20f), bits(1e-20f)) == 0);
+    myassert(fpu::fmul(bits(-1e-20f), bits(1e-20f)) == 0x80000000);
+    myassert(fpu::fsqrt(0x80000000) == 0x80000000);
+    myassert(fpu::finv(0) == 0x7f800000);
+
+    myassert(fpu::itof(-3) == bits(-3.0f));
+    myassert(fpu::itof(16777217) == bits(16777216.0f));  // nearest even
+    myassert(fpu::ftoi(bits(2.5f)) == 3);                 // half away from 0
+    myassert(fpu::ftoi(bits(-2.5f)) == -3);
+    myassert(fpu::ftoi(bits(2.4f)) == 2);
+    myassert(fpu::ftoi(bits(0.49f)) == 0);
+    myassert(fpu::ftoi(bits(-123456.0f)) == -123456);
+
+    // error bounds on normal numbers
+    mt19937 rng{1};
+    for (int i = 0; i < 1000000; i++) {
+        auto a = static_cast<uint32_t>(rng() & 0x807fffff)
+                 | (100u + static_cast<uint32_t>(i % 50)) << 23;
+        auto b = static_cast<uint32_t>(rng() & 0x807fffff)
+                 | (100u + static_cast<uint32_t>(i % 60)) << 23;
+        double x = value(a), y = value(b);
+
+        myassert(fpu::fadd(a, b) == bits(value(a) + value(b)));
+        myassert(ulps(fpu::fmul(a, b), x * y) <= 0.5);
+        myassert(ulps(fpu::finv(b), 1 / y) <= 4);
+        myassert(ulps(fpu::fdiv(a, b), x / y) <= 5);
+        myassert(ulps(fpu::fsqrt(a & 0x7fffffff), sqrt(fabs(x))) <= 3);
+    }
+
+    // batch forms are the same as the scalar ones, on random bits covering
+    // zeros, denormals, infinities, NaNs and out of range ftoi
+    const size_t n = 1 << 20;
+    vector<uint32_t> a(n), b(n), out(n);
+    for (size_t i = 0; i < n; i++) {
+        a[i] = static_cast<uint32_t>(rng());
+        b[i] = static_cast<uint32_t>(rng());
+        if (i % 4 == 0)
+            a[i] &= 0x807fffff;
+        if (i % 4 == 1)
+            b[i] |= 0x7f800000;
+    }
+    fpu::fadd(a.data(), b.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == fpu::fadd(a[i], b[i]));
+    fpu::fsub(a.data(), b.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == fpu::fsub(a[i], b[i]));
+    fpu::fmul(a.data(), b.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == fpu::fmul(a[i], b[i]));
+    fpu::fdiv(a.data(), b.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == fpu::fdiv(a[i], b[i]));
+    fpu::finv(b.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == fpu::finv(b[i]));
+    fpu::fsqrt(a.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == fpu::fsqrt(a[i]));
+    fpu::itof(a.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == fpu::itof(static_cast<int32_t>(a[i])));
+    fpu::ftoi(b.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        myassert(out[i] == static_cast<uint32_t>(fpu::ftoi(b[i])));
+
+    cerr << "All test passed" << endl;
+
+    return 0;
+}
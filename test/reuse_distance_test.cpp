@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "reuse_distance.hpp"
+
+using namespace std;
+
+#define myassert(b)                                        \
+    if (not(b)) {                                          \
+        cerr << "Assertion failed @ " << __LINE__ << endl; \
+        return 1;                                          \
+    }
+
+int main()
+{
+    {
+        ReuseDistance r{4};
+        myassert(r.access(0) == ReuseDistance::COLD);
+        myassert(r.access(1) == ReuseDistance::COLD);
+        myassert(r.access(1) == 0);
+        myassert(r.access(2) == ReuseDistance::COLD);
+        myassert(r.access(0) == 2);
+        myassert(r.access(1) == 2);
+        myassert(r.access(1) == 0);
+        myassert(r.access(2) == 2);
+    }
+
+    // Against an LRU stack, long enough to be compacted several times
+    constexpr size_t LINE_NUM = 300;
+    ReuseDistance r{LINE_NUM};
+    vector<size_t> stack;  // most recent first
+    mt19937 rng{1};
+    for (int i = 0; i < 500000; i++) {
+        // mostly local, sometimes anywhere
+        size_t line = rng() % 8 == 0 ? rng() % LINE_NUM : rng() % 20;
+
+        auto it = find(stack.begin(), stack.end(), line);
+        int64_t expected = ReuseDistance::COLD;
+        if (it != stack.end()) {
+            expected = it - stack.begin();
+            stack.erase(it);
+        }
+        stack.insert(stack.begin(), line);
+
+        myassert(r.access(line) == expected);
+    }
+
+    cerr << "All test passed" << endl;
+
+    return 0;
+}
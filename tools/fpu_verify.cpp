@@ -0,0 +1,469 @@
+/*
+ * Verify the provisional FPU model (src/fpu.cpp) against the host FPU, which
+ * is what the simulator uses.
+ *
+ * Unary operations are checked on all 2^32 inputs. Binary operations are
+ * checked on random operands stratified by exponent: the exponent pairs of
+ * the operands go round all combinations of normal exponents, and one case
+ * in 16 takes fully random bits to cover zeros, denormals, infinities and
+ * NaNs.
+ * The cases are split into chunks shared by all cores. The model results of
+ * a chunk are computed at once by the batch forms of src/fpu.hpp, and the
+ * host results 8 at a time with AVX2 on x86-64 CPUs having it.
+ * For each operation, a histogram of the distance from the host result in
+ * ULP and the first mismatches in the order of the cases are reported.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "fpu.hpp"
+
+namespace
+{
+
+enum class Op { FADD, FSUB, FMUL, FDIV, FINV, FSQRT, ITOF, FTOI };
+
+struct OpInfo {
+    const char* name;
+    Op op;
+    bool binary;
+    bool int_result;
+};
+
+const OpInfo OPS[] = {
+    {"fadd", Op::FADD, true, false},
+    {"fsub", Op::FSUB, true, false},
+    {"fmul", Op::FMUL, true, false},
+    {"fdiv", Op::FDIV, true, false},
+    {"finv", Op::FINV, false, false},
+    {"fsqrt", Op::FSQRT, false, false},
+    {"itof", Op::ITOF, false, false},
+    {"ftoi", Op::FTOI, false, true},
+};
+
+constexpr size_t CHUNK_SIZE = 1 << 16;
+
+// Histogram buckets of the distance in ULP: 0, 1, 2, 3, 4, 5-8, 9-16, 17-
+// and the NaN mismatches (one side is NaN and the other isn't)
+constexpr int BUCKET_NUM = 9;
+const char* const BUCKET_NAMES[BUCKET_NUM]
+    = {"0", "1", "2", "3", "4", "5-8", "9-16", "17-", "NaN"};
+constexpr int NAN_BUCKET = BUCKET_NUM - 1;
+
+struct Mismatch {
+    uint64_t index;
+    uint32_t a, b, model, host;
+    uint64_t ulp;
+};
+
+struct Result {
+    uint64_t hist[BUCKET_NUM] = {};
+    uint64_t max_ulp = 0;
+    std::vector<Mismatch> mismatches;  // sorted by index
+
+    void merge(const Result& other, size_t keep)
+    {
+        for (int i = 0; i < BUCKET_NUM; i++)
+            hist[i] += other.hist[i];
+        max_ulp = std::max(max_ulp, other.max_ulp);
+        std::vector<Mismatch> merged;
+        std::merge(mismatches.begin(), mismatches.end(),
+            other.mismatches.begin(), other.mismatches.end(),
+            std::back_inserter(merged),
+            [](const Mismatch& l, const Mismatch& r) { return l.index < r.index; });
+        if (merged.size() > keep)
+            merged.resize(keep);
+        mismatches.swap(merged);
+    }
+};
+
+float toFloat(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof f);
+    return f;
+}
+
+uint32_t toBits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof u);
+    return u;
+}
+
+bool isNaN(uint32_t u) { return (u & 0x7fffffff) > 0x7f800000; }
+
+// Monotonic map from float bits to integers, with +0 and -0 equal
+int64_t ordered(uint32_t u)
+{
+    auto mag = static_cast<int64_t>(u & 0x7fffffff);
+    return u & 0x80000000 ? -mag : mag;
+}
+
+uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+void makeOperands(const OpInfo& info, uint64_t seed, uint64_t begin, size_t n,
+    uint32_t* a, uint32_t* b)
+{
+    if (not info.binary) {
+        for (size_t i = 0; i < n; i++)
+            a[i] = static_cast<uint32_t>(begin + i);
+        return;
+    }
+
+    constexpr uint64_t EXP_PAIRS = 254 * 254;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t k = begin + i;
+        uint64_t r = splitmix64(seed ^ splitmix64(k));
+        auto ra = static_cast<uint32_t>(r), rb = static_cast<uint32_t>(r >> 32);
+        if (k % 16 == 15) {
+            a[i] = ra;
+            b[i] = rb;
+            continue;
+        }
+        uint64_t pair = (k - k / 16) % EXP_PAIRS;
+        auto ea = static_cast<uint32_t>(1 + pair / 254);
+        auto eb = static_cast<uint32_t>(1 + pair % 254);
+        a[i] = (ra & 0x807fffff) | ea << 23;
+        b[i] = (rb & 0x807fffff) | eb << 23;
+    }
+}
+
+void modelBatch(Op op, const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n)
+{
+    switch (op) {
+    case Op::FADD:
+        fpu::fadd(a, b, out, n);
+        break;
+    case Op::FSUB:
+        fpu::fsub(a, b, out, n);
+        break;
+    case Op::FMUL:
+        fpu::fmul(a, b, out, n);
+        break;
+    case Op::FDIV:
+        fpu::fdiv(a, b, out, n);
+        break;
+    case Op::FINV:
+        fpu::finv(a, out, n);
+        break;
+    case Op::FSQRT:
+        fpu::fsqrt(a, out, n);
+        break;
+    case Op::ITOF:
+        fpu::itof(a, out, n);
+        break;
+    case Op::FTOI:
+        fpu::ftoi(a, out, n);
+        break;
+    default:
+        break;
+    }
+}
+
+// Same as cvt_w_s on x86: nearest even, 0x80000000 if invalid
+uint32_t hostFtoi(float f)
+{
+    float r = std::nearbyint(f);
+    if (not(r >= -2147483648.0f && r < 2147483648.0f))
+        return 0x80000000;
+    return static_cast<uint32_t>(static_cast<int32_t>(r));
+}
+
+void hostScalar(Op op, const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        float x = toFloat(a[i]), y = toFloat(b[i]);
+        switch (op) {
+        case Op::FADD:
+            out[i] = toBits(x + y);
+            break;
+        case Op::FSUB:
+            out[i] = toBits(x - y);
+            break;
+        case Op::FMUL:
+            out[i] = toBits(x * y);
+            break;
+        case Op::FDIV:
+            out[i] = toBits(x / y);
+            break;
+        case Op::FINV:
+            out[i] = toBits(1.0f / x);
+            break;
+        case Op::FSQRT:
+            out[i] = toBits(std::sqrt(x));
+            break;
+        case Op::ITOF:
+            out[i] = toBits(static_cast<float>(static_cast<int32_t>(a[i])));
+            break;
+        case Op::FTOI:
+            out[i] = hostFtoi(x);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+// n must be a multiple of 8. Relies on the default MXCSR (nearest even,
+// no flush to zero), as the scalar version does.
+__attribute__((target("avx2"))) void hostAvx2(
+    Op op, const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (size_t i = 0; i < n; i += 8) {
+        __m256i ai = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i bi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256 x = _mm256_castsi256_ps(ai), y = _mm256_castsi256_ps(bi);
+        __m256i r;
+        switch (op) {
+        case Op::FADD:
+            r = _mm256_castps_si256(_mm256_add_ps(x, y));
+            break;
+        case Op::FSUB:
+            r = _mm256_castps_si256(_mm256_sub_ps(x, y));
+            break;
+        case Op::FMUL:
+            r = _mm256_castps_si256(_mm256_mul_ps(x, y));
+            break;
+        case Op::FDIV:
+            r = _mm256_castps_si256(_mm256_div_ps(x, y));
+            break;
+        case Op::FINV:
+            r = _mm256_castps_si256(_mm256_div_ps(one, x));
+            break;
+        case Op::FSQRT:
+            r = _mm256_castps_si256(_mm256_sqrt_ps(x));
+            break;
+        case Op::ITOF:
+            r = _mm256_castps_si256(_mm256_cvtepi32_ps(ai));
+            break;
+        case Op::FTOI:
+            r = _mm256_cvtps_epi32(x);
+            break;
+        default:
+            r = _mm256_setzero_si256();
+            break;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+    }
+}
+#endif
+
+void record(Result& result, uint64_t index, uint32_t a, uint32_t b,
+    uint32_t model, uint32_t host, bool int_result, uint64_t tolerance, size_t keep)
+{
+    uint64_t ulp;
+    int bucket;
+    if (int_result) {
+        auto d = static_cast<int64_t>(static_cast<int32_t>(model))
+                 - static_cast<int32_t>(host);
+        ulp = static_cast<uint64_t>(d < 0 ? -d : d);
+    } else if (isNaN(model) || isNaN(host)) {
+        ulp = isNaN(model) && isNaN(host) ? 0 : UINT64_MAX;
+    } else {
+        auto d = ordered(model) - ordered(host);
+        ulp = static_cast<uint64_t>(d < 0 ? -d : d);
+    }
+
+    if (ulp == UINT64_MAX)
+        bucket = NAN_BUCKET;
+    else if (ulp <= 4)
+        bucket = static_cast<int>(ulp);
+    else if (ulp <= 8)
+        bucket = 5;
+    else if (ulp <= 16)
+        bucket = 6;
+    else
+        bucket = 7;
+    result.hist[bucket]++;
+    if (bucket != NAN_BUCKET)
+        result.max_ulp = std::max(result.max_ulp, ulp);
+
+    if (ulp > tolerance && result.mismatches.size() < keep)
+        result.mismatches.push_back({index, a, b, model, host, ulp});
+}
+
+struct Options {
+    unsigned thread_num = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t binary_cases = uint64_t{1} << 30;
+    uint64_t seed = 1;
+    uint64_t tolerance = 0;
+    size_t keep = 10;
+#if defined(__x86_64__)
+    bool avx2 = __builtin_cpu_supports("avx2");
+#else
+    bool avx2 = false;
+#endif
+};
+
+Result verify(const OpInfo& info, const Options& options)
+{
+    uint64_t total = info.binary ? options.binary_cases : uint64_t{1} << 32;
+    uint64_t chunk_num = (total + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::atomic<uint64_t> next_chunk{0};
+    std::vector<Result> results(options.thread_num);
+
+    auto work = [&](Result& result) {
+        std::vector<uint32_t> a(CHUNK_SIZE), b(CHUNK_SIZE, 0), model(CHUNK_SIZE),
+            host(CHUNK_SIZE);
+        for (uint64_t c; (c = next_chunk++) < chunk_num;) {
+            uint64_t begin = c * CHUNK_SIZE;
+            auto n = static_cast<size_t>(std::min<uint64_t>(CHUNK_SIZE, total - begin));
+            makeOperands(info, options.seed, begin, n, a.data(), b.data());
+
+            modelBatch(info.op, a.data(), b.data(), model.data(), n);
+
+            size_t vec_n = 0;
+#if defined(__x86_64__)
+            vec_n = options.avx2 ? n / 8 * 8 : 0;
+            if (vec_n > 0)
+                hostAvx2(info.op, a.data(), b.data(), host.data(), vec_n);
+#endif
+            hostScalar(info.op, a.data() + vec_n, b.data() + vec_n,
+                host.data() + vec_n, n - vec_n);
+
+            for (size_t i = 0; i < n; i++)
+                record(result, begin + i, a[i], b[i], model[i], host[i],
+                    info.int_result, options.tolerance, options.keep);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < options.thread_num; t++)
+        threads.emplace_back(work, std::ref(results[t]));
+    for (auto& thread : threads)
+        thread.join();
+
+    // Each thread takes chunks in increasing order, so keeping the first
+    // ones of each thread is enough for the first ones of all
+    Result result;
+    for (const auto& r : results)
+        result.merge(r, options.keep);
+    return result;
+}
+
+void printResult(const OpInfo& info, const Options& options, const Result& result)
+{
+    uint64_t total = 0;
+    for (auto n : result.hist)
+        total += n;
+
+    printf("%s: %llu cases (%s)\n", info.name, static_cast<unsigned long long>(total),
+        info.binary ? "random" : "exhaustive");
+    printf("  %-6s %12s %10s\n", "ulp", "count", "ratio");
+    for (int i = 0; i < BUCKET_NUM; i++)
+        printf("  %-6s %12llu %9.5f%%\n", BUCKET_NAMES[i],
+            static_cast<unsigned long long>(result.hist[i]),
+            100.0 * static_cast<double>(result.hist[i]) / static_cast<double>(total));
+    printf("  max ulp: %llu\n", static_cast<unsigned long long>(result.max_ulp));
+
+    if (result.mismatches.empty()) {
+        printf("  no mismatch over %llu ulp\n",
+            static_cast<unsigned long long>(options.tolerance));
+        return;
+    }
+    printf("  first mismatches over %llu ulp:\n",
+        static_cast<unsigned long long>(options.tolerance));
+    for (const auto& m : result.mismatches) {
+        if (info.binary)
+            printf("    a=%08x b=%08x", m.a, m.b);
+        else
+            printf("    a=%08x", m.a);
+        printf(" model=%08x host=%08x", m.model, m.host);
+        if (m.ulp == UINT64_MAX)
+            printf(" (NaN)\n");
+        else
+            printf(" (%llu ulp)\n", static_cast<unsigned long long>(m.ulp));
+    }
+}
+
+void printHelp()
+{
+    printf("Usage: fpu_verify [-j threads] [-n cases] [-s seed] [-t ulp] [-k count] [-S]"
+           " [op...]\n"
+           "  op: fadd fsub fmul fdiv finv fsqrt itof ftoi (default: all)\n"
+           "  -n: number of cases for binary operations (default: 2^30)\n"
+           "  -t: ulp allowed before reporting a mismatch (default: 0)\n"
+           "  -k: number of mismatches reported (default: 10)\n"
+           "  -S: don't use AVX2 for the host results\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+
+    Options options;
+
+    int result;
+    while ((result = getopt(argc, argv, "j:n:s:t:k:Sh")) != -1) {
+        switch (result) {
+        case 'j':
+            options.thread_num = max(1u, static_cast<unsigned>(stoul(optarg)));
+            break;
+        case 'n':
+            options.binary_cases = stoull(optarg);
+            break;
+        case 's':
+            options.seed = stoull(optarg);
+            break;
+        case 't':
+            options.tolerance = stoull(optarg);
+            break;
+        case 'k':
+            options.keep = static_cast<size_t>(stoul(optarg));
+            break;
+        case 'S':
+            options.avx2 = false;
+            break;
+        case 'h':
+            printHelp();
+            return 0;
+        default:
+            printHelp();
+            return 1;
+        }
+    }
+
+    vector<const OpInfo*> ops;
+    for (int i = optind; i < argc; i++) {
+        auto it = find_if(begin(OPS), end(OPS),
+            [&](const OpInfo& info) { return argv[i] == string(info.name); });
+        if (it == end(OPS)) {
+            cerr << "Unknown operation: " << argv[i] << endl;
+            printHelp();
+            return 1;
+        }
+        ops.push_back(&*it);
+    }
+    if (ops.empty())
+        for (const auto& info : OPS)
+            ops.push_back(&info);
+
+    fprintf(stderr, "threads: %u, AVX2: %s\n", options.thread_num,
+        options.avx2 ? "on" : "off");
+    for (auto info : ops) {
+        printResult(*info, options, verify(*info, options));
+        fflush(stdout);
+    }
+
+    return 0;
+}
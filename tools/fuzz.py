@@ -0,0 +1,461 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+""" Differential tester of the simulator
+
+Usage: fuzz.py [-n programs] [-j jobs] [-s seed] [-l length]
+               [-c config,...] [-o dir] [--simulator path] [--no-minimize]
+
+gen_instruction.pyの命令表からランダムなプログラムを生成し、
+いくつかの実行設定（-b, -b -x, -b -u, -b -m, -w など）で並列に実行して、
+最終的なレジスタ、メモリのハッシュ、OUT命令の出力、命令数を比べます。
+結果が食い違うか、どれかが異常終了したプログラムは、
+スニペットを取り除けるだけ取り除いて最小化し、-oのディレクトリに保存します。
+
+生成されるプログラムは必ず停止します。
+分岐とジャンプは同じスコープの前方のラベルにだけ飛び、
+後方への分岐は回数を決めたループの末尾だけです。
+メモリアクセスは先頭のMEMORY_WORDSワードに収まります。
+プログラムの最後で、レジスタとメモリのハッシュをOUT命令で出力するので、
+レジスタを出力しない-wでも比べられます。
+"""
+
+import argparse
+import concurrent.futures
+import hashlib
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from gen_instruction import insts, mnemonic  # noqa: E402
+
+opcodes = {c[0]: (n, c[1], c[2]) for (n, c) in insts.items()}
+
+CONFIGS = {
+    'unfused': ['-b', '-x'],
+    'headless': ['-b'],
+    'unchecked': ['-b', '-u'],
+    'memory': ['-b', '-m'],
+    'unchecked-memory': ['-b', '-u', '-m'],
+    'writer': ['-b', '-W', '2'],
+    'loops': ['-b', '-L'],
+    'reuse': ['-b', '-m', '-R', '4'],
+    'prefetch': ['-b', '-P', 'next-line,stride:4'],
+    'interval': ['-b', '-I', '64'],
+    'sweep': ['-w', 'list', '-j', '1'],
+}
+
+MEMORY_WORDS = 1024
+INPUT_SIZE = 1 << 16
+TIMEOUT = 10
+
+# Registers the random code may write. The others are reserved:
+#   r0: zero, r23-r27: scratch and epilogue, r28: loop counter
+GPRS = list(range(1, 23)) + [29, 30, 31]
+SCRATCH = 26
+COUNTER = 28
+
+# Instructions generated by the special snippets below, not generically
+SPECIAL = {'ASRT', 'ASRT_S', 'HALT', 'IN', 'OUT', 'DIV', 'DIVI',
+           'LW', 'LWO', 'SW', 'SWO', 'LWC1', 'LWOC1', 'SWC1', 'SWOC1',
+           'BEQ', 'BGEZ', 'BGTZ', 'BLEZ', 'BLTZ', 'BGEZAL', 'BLTZAL',
+           'J', 'JAL', 'JR', 'JALR'}
+BRANCHES = ['BEQ', 'BGEZ', 'BGTZ', 'BLEZ', 'BLTZ', 'BGEZAL', 'BLTZAL']
+
+
+class Label:
+    def __init__(self, name, scope):
+        self.name = name
+        self.scope = scope
+
+
+class Snippet:
+    """ Instructions removed or kept together when minimizing """
+
+    def __init__(self, code, scope, removable=True):
+        self.code = code  # [(name, {field: value})]
+        self.scope = scope
+        self.removable = removable
+
+
+def imm16(rng):
+    return rng.choice([rng.randrange(-0x8000, 0x8000), rng.randrange(-8, 8)])
+
+
+def generic(rng, name):
+    """ Operands from the field kinds: the last register field is written """
+
+    _, ty, fields = opcodes[name]
+    keys = ['rs', 'rt', 'rd', 'shamt'] if ty == 'R' else ['rs', 'rt', 'imm']
+    used = [(k, f) for (k, f) in zip(keys, fields) if f is not None]
+    regs = [k for (k, f) in used if f in ('R', 'F')]
+    ops = {}
+    for (k, f) in used:
+        if f == 'F':
+            ops[k] = rng.randrange(32)
+        elif f == 'R':
+            ops[k] = rng.choice(GPRS if k == regs[-1] else [0] + GPRS)
+        elif k == 'shamt':
+            ops[k] = rng.randrange(32)
+        else:
+            ops[k] = imm16(rng)
+    return [(name, ops)]
+
+
+def memory_offset(rng):
+    return rng.randrange(MEMORY_WORDS) * 4
+
+
+def special(rng, name, scope, labels):
+    """ Snippet keeping 'name' in bounds and terminating """
+
+    src = lambda: rng.choice([0] + GPRS)  # noqa: E731
+    dst = lambda: rng.choice(GPRS)  # noqa: E731
+    f = lambda: rng.randrange(32)  # noqa: E731
+    target = lambda: rng.choice(labels)  # noqa: E731
+
+    if name in ('ASRT', 'ASRT_S'):
+        k = imm16(rng)
+        code = [('ADDI', {'rs': 0, 'rt': SCRATCH, 'imm': k})]
+        if name == 'ASRT':
+            code.append(('ASRT', {'rs': SCRATCH}))
+        else:
+            r = f()
+            code += [('MTC1', {'rs': SCRATCH, 'rt': r}), ('ASRT_S', {'rs': r})]
+        return code + [('.word', {'value': k & 0xffffffff})]
+    if name == 'IN':
+        return [('IN', {'rd': dst()})]
+    if name == 'OUT':
+        return [('OUT', {'rs': src()})]
+    if name == 'DIV':
+        # positive and nonzero divisor
+        return [('ANDI', {'rs': src(), 'rt': SCRATCH, 'imm': 0x7fff}),
+                ('ORI', {'rs': SCRATCH, 'rt': SCRATCH, 'imm': 1}),
+                ('DIV', {'rs': src(), 'rt': SCRATCH, 'rd': dst()})]
+    if name == 'DIVI':
+        return [('DIVI', {'rs': src(), 'rt': dst(),
+                          'imm': rng.choice([1, -1]) * rng.randrange(2, 0x8000)})]
+    if name in ('LW', 'LWC1'):
+        return [(name, {'rs': 0, 'rt': f() if name == 'LWC1' else dst(),
+                        'imm': memory_offset(rng)})]
+    if name in ('SW', 'SWC1'):
+        return [(name, {'rs': f() if name == 'SWC1' else src(), 'rt': 0,
+                        'imm': memory_offset(rng)})]
+    if name in ('LWO', 'LWOC1', 'SWO', 'SWOC1'):
+        mask = [('ANDI', {'rs': src(), 'rt': SCRATCH,
+                          'imm': (MEMORY_WORDS - 1) * 4})]
+        if name in ('LWO', 'LWOC1'):
+            d = f() if name == 'LWOC1' else dst()
+            return mask + [(name, {'rs': SCRATCH, 'rt': 0, 'rd': d})]
+        v = f() if name == 'SWOC1' else src()
+        return mask + [(name, {'rs': v, 'rt': SCRATCH, 'rd': 0})]
+    if name in BRANCHES:
+        ops = {'rs': src(), 'label': target()}
+        if name == 'BEQ':
+            ops['rt'] = src()
+        return [(name, ops)]
+    if name in ('J', 'JAL'):
+        return [(name, {'label': target()})]
+    if name in ('JR', 'JALR'):
+        return [('ADDI', {'rs': 0, 'rt': SCRATCH, 'address': target()}),
+                (name, {'rs': SCRATCH, 'rt': dst()})]
+    return []  # HALT
+
+
+def generate(rng, length):
+    """ Random program as a list of Labels and Snippets """
+
+    names = [c[0] for c in insts.values() if c[0] != 'HALT']
+    items = []
+    label_num = [0]
+
+    def new_label(scope):
+        label_num[0] += 1
+        return Label('L{}'.format(label_num[0]), scope)
+
+    def body(scope, n):
+        # labels first, so that every branch has a forward target
+        out = []
+        for _ in range(n):
+            if rng.random() < 0.2:
+                out.append(new_label(scope))
+            out.append(None)
+        end = new_label(scope)
+        out.append(end)
+
+        for i, item in enumerate(out):
+            if item is not None:
+                continue
+            later = [x.name for x in out[i + 1:] if isinstance(x, Label)]
+            name = rng.choice(names)
+            code = special(rng, name, scope, later) if name in SPECIAL \
+                else generic(rng, name)
+            out[i] = Snippet(code, scope)
+        return out
+
+    loop_num = 0
+    while length > 0:
+        n = min(length, rng.randrange(1, 40))
+        length -= n
+        if rng.random() < 0.3:
+            loop_num += 1
+            scope = 'loop{}'.format(loop_num)
+            head = new_label(scope)
+            items.append(Snippet([('ADDI', {'rs': 0, 'rt': COUNTER,
+                                            'imm': rng.randrange(1, 9)})],
+                                 'top', removable=False))
+            items.append(head)
+            items += body(scope, n)
+            items.append(Snippet([('ADDI', {'rs': COUNTER, 'rt': COUNTER,
+                                            'imm': -1}),
+                                  ('BGTZ', {'rs': COUNTER,
+                                            'label': head.name})],
+                                 scope, removable=False))
+        else:
+            items += body('top', n)
+
+    items.append(Snippet(epilogue(), 'top', removable=False))
+    return items
+
+
+def epilogue():
+    """ OUT every register and a hash of the memory, then HALT """
+
+    code = []
+
+    def out_word(r):
+        code.append(('OUT', {'rs': r}))
+        for s in (8, 16, 24):
+            code.append(('SRL', {'rs': r, 'rd': 23, 'shamt': s}))
+            code.append(('OUT', {'rs': 23}))
+
+    for r in GPRS:
+        out_word(r)
+    for r in range(32):
+        code.append(('MFC1', {'rs': r, 'rt': 24}))
+        out_word(24)
+
+    # r27 = rotl(r27, 5) ^ memory[i] for all i
+    code += [('ADDI', {'rs': 0, 'rt': 25, 'imm': 0}),
+             ('ADDI', {'rs': 0, 'rt': 27, 'imm': 0}),
+             ('SLL', {'rs': 27, 'rd': 23, 'shamt': 5}),
+             ('SRL', {'rs': 27, 'rd': 24, 'shamt': 27}),
+             ('OR_', {'rs': 23, 'rt': 24, 'rd': 27}),
+             ('LW', {'rs': 25, 'rt': 24, 'imm': 0}),
+             ('XOR_', {'rs': 27, 'rt': 24, 'rd': 27}),
+             ('ADDI', {'rs': 25, 'rt': 25, 'imm': 4}),
+             ('ADDI', {'rs': 0, 'rt': 24, 'imm': MEMORY_WORDS * 4}),
+             ('SUB', {'rs': 24, 'rt': 25, 'rd': 24}),
+             ('BGTZ', {'rs': 24, 'offset': -8})]
+    out_word(27)
+    code.append(('HALT', {}))
+    return code
+
+
+def assemble(items):
+    """ Binary and listing of the program """
+
+    addrs = {}
+    idx = 0
+    for item in items:
+        if isinstance(item, Label):
+            addrs[item.name] = idx
+        else:
+            idx += len(item.code)
+
+    referenced = {ops.get('label', ops.get('address'))
+                  for item in items if isinstance(item, Snippet)
+                  for (_, ops) in item.code}
+
+    words, listing = [], []
+    for item in items:
+        if isinstance(item, Label):
+            if item.name in referenced:
+                listing.append('{}:'.format(item.name))
+            continue
+        for (name, ops) in item.code:
+            pc = len(words)
+            if name == '.word':
+                words.append(ops['value'])
+                listing.append('    .word 0x{:08x}'.format(ops['value']))
+                continue
+
+            n, ty, _ = opcodes[name]
+            imm = ops.get('imm', 0)
+            if 'label' in ops:
+                imm = addrs[ops['label']] - pc
+            if 'offset' in ops:
+                imm = ops['offset']
+            if 'address' in ops:
+                imm = addrs[ops['address']] * 4
+
+            if ty == 'J':
+                w = n << 26 | (addrs[ops['label']] & 0x1fffff)
+            elif ty == 'R':
+                w = n << 26 | ops.get('rs', 0) << 21 | ops.get('rt', 0) << 16 \
+                    | ops.get('rd', 0) << 11 | ops.get('shamt', 0) << 6
+            else:
+                w = n << 26 | ops.get('rs', 0) << 21 | ops.get('rt', 0) << 16 \
+                    | (imm & 0xffff)
+            words.append(w)
+            args = ' '.join('{}={}'.format(k, v) for (k, v) in sorted(ops.items()))
+            listing.append('    {:5d} {:<8} {}'.format(pc, mnemonic(name), args))
+
+    return struct.pack('={}I'.format(len(words)), *words), '\n'.join(listing) + '\n'
+
+
+def run(simulator, binary, inputs, config):
+    """ Outcome of one configuration: {artifact: digest} """
+
+    work = tempfile.mkdtemp(prefix='felis-fuzz-')
+    try:
+        with open(os.path.join(work, 'prog.bin'), 'wb') as f:
+            f.write(binary)
+        with open(os.path.join(work, 'input'), 'wb') as f:
+            f.write(inputs)
+        with open(os.path.join(work, 'list'), 'w') as f:
+            f.write('input\n')
+
+        cmd = [simulator, '-f', 'prog.bin', '-i', 'input', '-o', 'out.log',
+               '-s', str(MEMORY_WORDS)] + CONFIGS[config]
+        try:
+            p = subprocess.run(cmd, cwd=work, stdout=subprocess.DEVNULL,
+                               stderr=subprocess.PIPE, timeout=TIMEOUT)
+        except subprocess.TimeoutExpired:
+            return {'exit': 'timeout'}
+        outcome = {'exit': str(p.returncode)}
+        if p.returncode != 0:
+            outcome['stderr'] = p.stderr.decode(errors='replace').strip()
+            return outcome
+
+        files = {'out': 'out.log.0' if config == 'sweep' else 'out.log',
+                 'register': 'register.log',
+                 'memory': 'memory.log',
+                 'instruction': 'instruction.log',
+                 'call_cnt': 'call_cnt.log'}
+        for (artifact, name) in files.items():
+            path = os.path.join(work, name)
+            if os.path.exists(path):
+                with open(path, 'rb') as f:
+                    data = f.read()
+                if artifact == 'instruction':  # in hash table order
+                    data = b''.join(sorted(data.splitlines(True)))
+                outcome[artifact] = hashlib.sha1(data).hexdigest()
+        return outcome
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+def compare(outcomes):
+    """ Descriptions of the differences, empty if all agree """
+
+    problems = []
+    for (config, o) in sorted(outcomes.items()):
+        if o['exit'] != '0':
+            problems.append('{}: exit {} {}'.format(
+                config, o['exit'], o.get('stderr', '')))
+    artifacts = sorted({a for o in outcomes.values() for a in o} - {'exit', 'stderr'})
+    for a in artifacts:
+        digests = {c: o[a] for (c, o) in outcomes.items() if a in o}
+        if len(set(digests.values())) > 1:
+            problems.append('{} differs: {}'.format(a, ', '.join(
+                '{}={}'.format(c, d[:8]) for (c, d) in sorted(digests.items()))))
+    return problems
+
+
+def check(pool, simulator, items, inputs, configs):
+    binary, _ = assemble(items)
+    futures = {c: pool.submit(run, simulator, binary, inputs, c) for c in configs}
+    return compare({c: f.result() for (c, f) in futures.items()})
+
+
+def minimize(pool, simulator, items, inputs, configs):
+    """ Remove snippets as long as the program still fails """
+
+    chunk = len(items) // 2
+    while chunk >= 1:
+        i = 0
+        while i < len(items):
+            removed = [x for x in items[i:i + chunk]
+                       if isinstance(x, Snippet) and x.removable]
+            if removed:
+                candidate = [x for x in items if not any(x is r for r in removed)]
+                if check(pool, simulator, candidate, inputs, configs):
+                    items = candidate
+                    continue
+            i += chunk
+        chunk //= 2
+    return items
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Differential tester of the simulator')
+    parser.add_argument('-n', type=int, default=100, help='number of programs')
+    parser.add_argument('-j', type=int, default=os.cpu_count(),
+                        help='number of parallel runs')
+    parser.add_argument('-s', type=int, default=1, help='seed')
+    parser.add_argument('-l', type=int, default=200, help='snippets per program')
+    parser.add_argument('-c', default=','.join(CONFIGS),
+                        help='configurations to compare')
+    parser.add_argument('-o', default='fuzz_failures',
+                        help='directory to save failing programs')
+    parser.add_argument('--simulator', default='./simulator')
+    parser.add_argument('--no-minimize', action='store_true')
+    args = parser.parse_args()
+
+    configs = args.c.split(',')
+    for c in configs:
+        if c not in CONFIGS:
+            sys.exit('Unknown configuration: {} (one of {})'.format(
+                c, ', '.join(CONFIGS)))
+    simulator = os.path.abspath(args.simulator)
+
+    failures = 0
+    with concurrent.futures.ThreadPoolExecutor(args.j) as pool:
+        def one(k):
+            rng = random.Random(args.s + k)
+            items = generate(rng, args.l)
+            inputs = bytes(rng.randrange(256) for _ in range(INPUT_SIZE))
+            binary, _ = assemble(items)
+            futures = {c: pool.submit(run, simulator, binary, inputs, c)
+                       for c in configs}
+            return items, inputs, compare({c: f.result() for (c, f) in futures.items()})
+
+        # the programs are checked in a separate pool, so that their runs
+        # don't wait behind one another in 'pool'
+        with concurrent.futures.ThreadPoolExecutor(args.j) as programs:
+            results = programs.map(one, range(args.n))
+            for k, (items, inputs, problems) in enumerate(results):
+                if not problems:
+                    continue
+                failures += 1
+                seed = args.s + k
+                print('seed {}: {}'.format(seed, '; '.join(problems)))
+                if not args.no_minimize:
+                    items = minimize(pool, simulator, items, inputs, configs)
+                    problems = check(pool, simulator, items, inputs, configs)
+
+                os.makedirs(args.o, exist_ok=True)
+                base = os.path.join(args.o, 'seed{}'.format(seed))
+                binary, listing = assemble(items)
+                with open(base + '.bin', 'wb') as f:
+                    f.write(binary)
+                with open(base + '.in', 'wb') as f:
+                    f.write(inputs)
+                with open(base + '.s', 'w') as f:
+                    f.write(''.join('# {}\n'.format(p) for p in problems))
+                    f.write(listing)
+                print('  saved {} ({} words)'.format(base + '.bin', len(binary) // 4))
+
+    print('{} / {} programs failed'.format(failures, args.n))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -102,10 +102,10 @@ def main():
             inst_cpp_tmp.write(inst_cpp_header)
             for inst_ in insts.values():
                 inst = inst_[0]
-                inst_hpp_tmp.write(
-                    '    PreState {}(Instruction);\n'.format(inst.lower(), ))
+                inst_hpp_tmp.write('''    template <class P>
+    PreState {}(Instruction);\n'''.format(inst.lower(), ))
                 inst_cpp_tmp.write('''    case OpCode::{}:
-        return {}(inst);\n'''.format(inst, inst.lower()))
+        return {}<P>(inst);\n'''.format(inst, inst.lower()))
             inst_cpp_tmp.write(inst_cpp_footer)
 
     # disassembler
@@ -121,12 +121,12 @@ def main():
         disasm_tmp.write(disasm_header)
         for (n, c) in insts.items():
             disasm_tmp.write(
-                '''    m_mnemonic_table.emplace(
+                '''    table.emplace(
         OpCode::{},
         Mnemonic{{"{}", OperandType::{},
             {}}});\n'''
                 .format(c[0], mnemonic(c[0]), c[1], operand_field(c[2])))
-        disasm_tmp.write('}\n')
+        disasm_tmp.write(disasm_footer)
 
     # tester
     with open(test_run_name, 'w') as run_tmp:
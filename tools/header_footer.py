@@ -27,6 +27,7 @@ struct hash<OpCode> {
 inst_cpp_header = '''#include "simulator.hpp"
 #include "util.hpp"
 
+template <class P>
 Simulator::PreState Simulator::execInst(OpCode opcode, Instruction inst)
 {
     switch (opcode) {
@@ -36,14 +37,23 @@ inst_cpp_footer = '''    default:
         FAIL("# Error: No such instruction");
     }
 }
+
+FELIS_SIM_INSTANTIATE_EXEC(execInst, (OpCode, Instruction))
 '''
 
 disasm_header = '''#include "simulator.hpp"
 
-void Simulator::initDisassembler()
+Simulator::MnemonicTable Simulator::makeMnemonicTable()
 {
     using Field = Mnemonic::OperandField;
 
+    MnemonicTable table;
+
+'''
+
+disasm_footer = '''
+    return table;
+}
 '''
 
 test_run_header = '''#!/bin/sh
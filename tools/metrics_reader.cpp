@@ -0,0 +1,166 @@
+/*
+ * Read the live metrics published by 'simulator -M <name>'.
+ *
+ * Without -p, a line of the metrics is printed every -i seconds until the
+ * simulator halts or exits. With -p, the metrics are printed once in the
+ * Prometheus text exposition format, e.g. for the textfile collector of
+ * node_exporter.
+ */
+#include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "metrics.hpp"
+
+namespace
+{
+
+void printHelp()
+{
+    fprintf(stderr,
+        "Usage: metrics_reader [-p] [-i seconds] <name>\n"
+        "  -p  print once in the Prometheus text format\n"
+        "  -i  interval of the lines (default 1)\n");
+}
+
+void printLine(const MetricsBlock& block, const MetricsBlock::Values& v)
+{
+    // The three most executed opcodes
+    int top[3] = {-1, -1, -1};
+    for (int op = 0; op < MetricsBlock::OPCODE_NUM; op++) {
+        for (int k = 0; k < 3; k++) {
+            if (top[k] < 0 || v.inst[op] > v.inst[top[k]]) {
+                for (int j = 2; j > k; j--)
+                    top[j] = top[j - 1];
+                top[k] = op;
+                break;
+            }
+        }
+    }
+
+    printf("inst %" PRId64 "  %.1f MIPS  PC %" PRIu32 "  footprint %" PRIu64
+           " KiB ",
+        v.dynamic_inst, v.mips, v.pc, v.footprint / 1024);
+    for (auto op : top) {
+        if (op >= 0 && v.inst[op] > 0)
+            printf(" %s %.1f%%", block.mnemonic[op],
+                100.0 * static_cast<double>(v.inst[op])
+                    / static_cast<double>(v.dynamic_inst));
+    }
+    printf("%s\n", v.halted ? "  halted" : "");
+    fflush(stdout);
+}
+
+void printPrometheus(const MetricsBlock& block, const MetricsBlock::Values& v)
+{
+    auto metric = [](const char* name, const char* type, const char* help) {
+        printf("# HELP felis_sim_%s %s\n# TYPE felis_sim_%s %s\n", name, help,
+            name, type);
+    };
+
+    metric("instructions_total", "counter", "Instructions executed");
+    printf("felis_sim_instructions_total %" PRId64 "\n", v.dynamic_inst);
+    metric("mips", "gauge", "Average MIPS since the start");
+    printf("felis_sim_mips %f\n", v.mips);
+    metric("elapsed_seconds", "gauge", "Seconds since the start");
+    printf("felis_sim_elapsed_seconds %f\n",
+        static_cast<double>(v.elapsed_ns) / 1e9);
+    metric("pc", "gauge", "Program counter");
+    printf("felis_sim_pc %" PRIu32 "\n", v.pc);
+    metric("halted", "gauge", "1 if the program has halted");
+    printf("felis_sim_halted %" PRIu32 "\n", v.halted);
+    metric("memory_footprint_bytes", "gauge", "Touched pages of the memory");
+    printf("felis_sim_memory_footprint_bytes %" PRIu64 "\n", v.footprint);
+
+    metric("opcode_instructions_total", "counter",
+        "Instructions executed by opcode");
+    for (int op = 0; op < MetricsBlock::OPCODE_NUM; op++) {
+        if (block.mnemonic[op][0] != '\0')
+            printf("felis_sim_opcode_instructions_total{opcode=\"%s\"} %" PRId64
+                   "\n",
+                block.mnemonic[op], v.inst[op]);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    bool prometheus = false;
+    double interval = 1.0;
+
+    int result;
+    while ((result = getopt(argc, argv, "pi:h")) != -1) {
+        switch (result) {
+        case 'p':
+            prometheus = true;
+            break;
+        case 'i':
+            interval = std::stod(optarg);
+            break;
+        case 'h':
+            printHelp();
+            return 0;
+        default:
+            printHelp();
+            return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        printHelp();
+        return 1;
+    }
+
+    auto name = '/' + std::string{argv[optind]};
+    auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Shared memory %s couldn't be opened\n", name.c_str());
+        return 1;
+    }
+    auto p = mmap(nullptr, sizeof(MetricsBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "Shared memory %s couldn't be mapped\n", name.c_str());
+        return 1;
+    }
+    const auto& block = *static_cast<const MetricsBlock*>(p);
+    if (block.magic != MetricsBlock::MAGIC
+        || block.version != MetricsBlock::VERSION) {
+        fprintf(stderr, "%s is not a metrics segment of version %u\n",
+            name.c_str(), MetricsBlock::VERSION);
+        return 1;
+    }
+
+    // The mapping outlives the segment, so watch the process
+    auto alive = [&block]() {
+        return kill(static_cast<pid_t>(block.pid), 0) == 0;
+    };
+    MetricsBlock::Values v;
+    if (prometheus) {
+        if (not block.read(v)) {
+            fprintf(stderr, "%s is being written\n", name.c_str());
+            return 1;
+        }
+        printPrometheus(block, v);
+        return 0;
+    }
+
+    while (true) {
+        if (block.read(v)) {
+            printLine(block, v);
+            if (v.halted || not alive())
+                return 0;
+        } else if (not alive()) {
+            fprintf(stderr, "%s was left in the middle of an update\n",
+                name.c_str());
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+}
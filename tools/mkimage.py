@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+""" Make a sectioned executable image
+
+Usage: mkimage.py [-o output] [-e entry] [-d addr:file]... [-s symbols] text.bin
+
+.binの命令列に、メモリに置く初期化済みデータ、開始PC、シンボル表を加えた
+実行イメージを作ります。simulatorは-fで.binと同じように読み込み、
+データを実行前にメモリへ直接置きます。形式はsrc/image.cppを参照してください。
+
+-dのファイルはリトルエンディアンの32bitワードの列で、addrはワード単位の
+メモリのインデックスです。-sのファイルは一行に「名前 値」（値はPCならバイト単位）
+を書いたもので、-dの逆アセンブルにラベルとして出力されます。
+-eと-dのaddrには、シンボル名も書けます。
+"""
+
+import argparse
+import struct
+import sys
+
+IMAGE_MAGIC = b'\x7fFEL'
+IMAGE_VERSION = 1
+
+SECTION_TEXT = 1
+SECTION_DATA = 2
+SECTION_SYMBOLS = 3
+
+HEADER = struct.Struct('<4sIII')
+SECTION = struct.Struct('<4I')
+
+
+def load_symbols(path):
+    symbols = {}
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            fields = line.split('#')[0].split()
+            if not fields:
+                continue
+            if len(fields) != 2:
+                sys.exit('# Error: {}:{}: Invalid symbol'.format(path, n))
+            symbols[fields[0]] = int(fields[1], 0)
+    return symbols
+
+
+def value(text, symbols):
+    if text in symbols:
+        return symbols[text]
+    try:
+        return int(text, 0)
+    except ValueError:
+        sys.exit('# Error: Unknown symbol: ' + text)
+
+
+def read_words(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) % 4 != 0:
+        sys.exit('# Error: {} is not a sequence of words'.format(path))
+    return data
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Make a sectioned executable image')
+    parser.add_argument('text', help='codes (.bin)')
+    parser.add_argument('-o', default='a.img', help='output')
+    parser.add_argument('-e', default='0', help='entry PC in bytes')
+    parser.add_argument('-d', action='append', default=[],
+                        metavar='ADDR:FILE', help='data at the word index')
+    parser.add_argument('-s', help='symbols, "name value" per line')
+    args = parser.parse_args()
+
+    symbols = load_symbols(args.s) if args.s else {}
+
+    sections = [(SECTION_TEXT, 0, read_words(args.text))]
+    for spec in args.d:
+        addr, _, path = spec.partition(':')
+        if not path:
+            sys.exit('# Error: Invalid data: ' + spec)
+        sections.append((SECTION_DATA, value(addr, symbols), read_words(path)))
+    if symbols:
+        table = b''.join(struct.pack('<I', v & 0xffffffff) + name.encode()
+                         + b'\0' for name, v in symbols.items())
+        sections.append((SECTION_SYMBOLS, 0, table))
+
+    entry = value(args.e, symbols)
+    if entry % 4 != 0 or entry >= len(sections[0][2]):
+        sys.exit('# Error: Entry point {} out of the text'.format(entry))
+
+    offset = HEADER.size + SECTION.size * len(sections)
+    table = []
+    for kind, addr, data in sections:
+        table.append(SECTION.pack(kind, addr, offset, len(data)))
+        offset += (len(data) + 3) // 4 * 4
+
+    with open(args.o, 'wb') as f:
+        f.write(HEADER.pack(IMAGE_MAGIC, IMAGE_VERSION, entry, len(sections)))
+        f.writelines(table)
+        for _, _, data in sections:
+            f.write(data + b'\0' * (-len(data) % 4))
+
+
+if __name__ == '__main__':
+    main()
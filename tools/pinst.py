@@ -6,12 +6,16 @@ from gen_instruction import insts, mnemonic
 fn = sys.argv[1] if len(sys.argv) > 1 else 'instruction.log'
 
 counts = {}
-with open(fn) as f:
-    for l in f:
-        if l[0] == '#':
-            continue
-        inst, cnt = [int(x) for x in l.split()]
-        counts[inst] = cnt
+if fn.endswith('.bin'):
+    import stats2text
+    counts = dict(stats2text.load(fn).inst)
+else:
+    with open(fn) as f:
+        for l in f:
+            if l[0] == '#':
+                continue
+            inst, cnt = [int(x) for x in l.split()]
+            counts[inst] = cnt
 
 for inst in range(64):
     if inst in insts:
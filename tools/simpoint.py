@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+""" Choose simulation points from basic block vectors
+
+Usage: simpoint.py [-k max_k] [-d dims] [-s seed] [-o output] bbv.txt
+
+simulator -I <N> -Vが出力したbbv.txtの区間を、SimPointと同じように
+ランダム射影で次元を落としてからk-meansでクラスタリングし、
+クラスタごとに重心に最も近い区間を代表として選びます。
+kは1からmax_kまで試し、BICが最大値と最小値の幅の90%以上になる最小のkです。
+
+出力は「区間番号 重み」の行で、重みはクラスタの区間数の割合です。
+simulator -b -S <output>で、選んだ区間だけを詳細に実行します。
+"""
+
+import argparse
+import math
+import random
+import sys
+
+
+def load(path):
+    length = None
+    vectors = []
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#'):
+                if line.startswith('# interval = '):
+                    length = int(line.split('=')[1])
+                continue
+            if not line.startswith('T'):
+                continue
+            v = {}
+            for field in line[1:].split():
+                _, block, count = field.split(':')
+                v[int(block)] = int(count)
+            vectors.append(v)
+    if length is None:
+        sys.exit('# Error: No interval length in ' + path)
+    return length, vectors
+
+
+def project(vectors, dims, rng):
+    """Normalize each vector to the sum of 1 and project it to dims"""
+    basis = {}
+    points = []
+    for v in vectors:
+        total = sum(v.values()) or 1
+        p = [0.0] * dims
+        for block, count in v.items():
+            if block not in basis:
+                basis[block] = [rng.uniform(-1, 1) for _ in range(dims)]
+            w = count / total
+            for d, b in enumerate(basis[block]):
+                p[d] += w * b
+        points.append(p)
+    return points
+
+
+def dist2(a, b):
+    return sum((x - y) * (x - y) for x, y in zip(a, b))
+
+
+def kmeans(points, k, rng, iterations=100):
+    # k-means++ seeding
+    centers = [rng.choice(points)]
+    nearest = [dist2(p, centers[0]) for p in points]
+    while len(centers) < k:
+        total = sum(nearest)
+        if total == 0:
+            break
+        r = rng.uniform(0, total)
+        for i, d in enumerate(nearest):
+            r -= d
+            if r <= 0:
+                break
+        centers.append(points[i])
+        nearest = [min(n, dist2(p, points[i])) for n, p in zip(nearest, points)]
+
+    labels = [0] * len(points)
+    for _ in range(iterations):
+        changed = False
+        for i, p in enumerate(points):
+            c = min(range(len(centers)), key=lambda c: dist2(p, centers[c]))
+            if c != labels[i]:
+                labels[i] = c
+                changed = True
+        sums = [[0.0] * len(points[0]) for _ in centers]
+        sizes = [0] * len(centers)
+        for p, c in zip(points, labels):
+            sizes[c] += 1
+            for d, x in enumerate(p):
+                sums[c][d] += x
+        centers = [[x / sizes[c] for x in s] if sizes[c] else centers[c]
+                   for c, s in enumerate(sums)]
+        if not changed:
+            break
+    return centers, labels
+
+
+def bic(points, centers, labels):
+    """BIC of spherical Gaussians, as X-means and SimPoint"""
+    r, m, k = len(points), len(points[0]), len(centers)
+    sse = sum(dist2(p, centers[c]) for p, c in zip(points, labels))
+    variance = max(sse / max(r - k, 1), 1e-12)
+    sizes = [labels.count(c) for c in range(k)]
+    likelihood = 0.0
+    for n in sizes:
+        if n == 0:
+            continue
+        likelihood += (n * math.log(n) - n * math.log(r)
+                       - n / 2 * math.log(2 * math.pi)
+                       - n * m / 2 * math.log(variance) - (n - k) / 2)
+    params = (k - 1) + m * k + 1
+    return likelihood - params / 2 * math.log(r)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Choose simulation points from basic block vectors')
+    parser.add_argument('bbv')
+    parser.add_argument('-k', type=int, default=10, help='max clusters')
+    parser.add_argument('-d', type=int, default=15, help='projected dims')
+    parser.add_argument('-s', type=int, default=1, help='seed')
+    parser.add_argument('-n', type=int, default=5,
+                        help='k-means runs for each k')
+    parser.add_argument('-o', default='simpoints.txt', help='output')
+    args = parser.parse_args()
+
+    length, vectors = load(args.bbv)
+    if not vectors:
+        sys.exit('# Error: No interval in ' + args.bbv)
+
+    rng = random.Random(args.s)
+    points = project(vectors, args.d, rng)
+
+    results = []
+    for k in range(1, min(args.k, len(points)) + 1):
+        best = None
+        for _ in range(args.n):
+            centers, labels = kmeans(points, k, rng)
+            score = bic(points, centers, labels)
+            if best is None or score > best[0]:
+                best = (score, centers, labels)
+        results.append(best)
+
+    scores = [r[0] for r in results]
+    threshold = min(scores) + 0.9 * (max(scores) - min(scores))
+    _, centers, labels = next(r for r in results if r[0] >= threshold)
+
+    chosen = []
+    for c, center in enumerate(centers):
+        members = [i for i, l in enumerate(labels) if l == c]
+        if not members:
+            continue
+        rep = min(members, key=lambda i: dist2(points[i], center))
+        chosen.append((rep, len(members) / len(points)))
+    chosen.sort()
+
+    with open(args.o, 'w') as f:
+        f.write('# interval = {}\n'.format(length))
+        f.write('# {} intervals, {} clusters\n'.format(len(points), len(chosen)))
+        for rep, weight in chosen:
+            f.write('{} {:.6f}\n'.format(rep, weight))
+
+    for rep, weight in chosen:
+        print('interval {:6} weight {:.4f}'.format(rep, weight))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+""" Convert stats.bin to the text logs
+
+Usage: stats2text.py [-o dir] [stats.bin]
+
+simulator -Bが出力したstats.binから、-Bなしで出力される
+call_cnt.log、instruction.log、register.log、memory.log、
+memory_access_cnt.logを作ります（stats.binに含まれるものだけ）。
+形式はsrc/binary_stats.cppを参照してください。
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+STATS_REGISTERS = 1
+STATS_MEMORY = 2
+STATS_MEMORY_ACCESS = 4
+
+HEADER = struct.Struct('<4sIII3q2Q')
+
+
+class Stats:
+    pass
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    s = Stats()
+    (magic, version, s.flags, code_num, s.dynamic_inst, s.samples,
+     s.simpoints, s.memory_num, s.memory_idx_max) = HEADER.unpack_from(data)
+    if magic != b'FSTB' or version != 1:
+        sys.exit('# Error: {} is not a stats.bin of version 1'.format(path))
+    pos = HEADER.size
+
+    s.pc_called = struct.unpack_from('<{}q'.format(code_num), data, pos)
+    pos += 8 * code_num
+
+    (inst_num,) = struct.unpack_from('<I', data, pos)
+    pos += 4
+    s.inst = [struct.unpack_from('<Iq', data, pos + 12 * i)
+              for i in range(inst_num)]
+    pos += 12 * inst_num
+
+    if s.flags & STATS_REGISTERS:
+        s.reg = struct.unpack_from('<32I', data, pos)
+        s.freg = struct.unpack_from('<32I', data, pos + 128)
+        pos += 256
+
+    if s.flags & STATS_MEMORY:
+        (range_num,) = struct.unpack_from('<I', data, pos)
+        pos += 4
+        s.ranges = []
+        for _ in range(range_num):
+            begin, length = struct.unpack_from('<II', data, pos)
+            pos += 8
+            s.ranges.append(
+                (begin, struct.unpack_from('<{}I'.format(length), data, pos)))
+            pos += 4 * length
+
+    if s.flags & STATS_MEMORY_ACCESS:
+        (access_num,) = struct.unpack_from('<Q', data, pos)
+        pos += 8
+        s.memory_access = list(
+            struct.iter_unpack('<II', data[pos:pos + 8 * access_num]))
+
+    return s
+
+
+def write(s, out):
+    def path(name):
+        return os.path.join(out, name)
+
+    with open(path('call_cnt.log'), 'w') as f:
+        f.write('# dynamic inst cnt = {}\n'.format(s.dynamic_inst))
+        if s.samples > 0:
+            f.write('# estimated from {} PC samples\n'.format(s.samples))
+        if s.simpoints > 0:
+            f.write('# estimated from {} intervals\n'.format(s.simpoints))
+        f.write('# PC : called cnt\n')
+        f.writelines('{} {}\n'.format(4 * i, c)
+                     for i, c in enumerate(s.pc_called))
+
+    with open(path('instruction.log'), 'w') as f:
+        f.write('# inst number : called cnt\n')
+        f.writelines('{} {}\n'.format(op, c) for op, c in s.inst)
+
+    if s.flags & STATS_REGISTERS:
+        with open(path('register.log'), 'w') as f:
+            f.write('# General purpose registers\n')
+            f.writelines('0x{:x}\n'.format(r) for r in s.reg)
+            f.write('# Floating point registers\n')
+            f.writelines('0x{:x}\n'.format(r) for r in s.freg)
+
+    if s.flags & STATS_MEMORY:
+        words = [0] * s.memory_num
+        for begin, values in s.ranges:
+            words[begin:begin + len(values)] = values
+        with open(path('memory.log'), 'w') as f:
+            f.write('# Max idx = {}\n'.format(s.memory_idx_max))
+            f.writelines('{:x}\n'.format(w) for w in words)
+
+    if s.flags & STATS_MEMORY_ACCESS:
+        with open(path('memory_access_cnt.log'), 'w') as f:
+            f.writelines('{} {}\n'.format(i, c) for i, c in s.memory_access)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert stats.bin to the text logs')
+    parser.add_argument('stats', nargs='?', default='stats.bin')
+    parser.add_argument('-o', default='.', help='output directory')
+    args = parser.parse_args()
+
+    write(load(args.stats), args.o)
+
+
+if __name__ == '__main__':
+    main()